@@ -0,0 +1,97 @@
+#include "capture.h"
+
+FrameCapture::FrameCapture(int width, int height, int outWidth, int outHeight, unsigned int depth, ImageWriter* writer)
+{
+    this->width = width;
+    this->height = height;
+    this->outWidth = outWidth;
+    this->outHeight = outHeight;
+    head = 0;
+    pWriter = writer;
+
+    slots.resize(depth > 0 ? depth : 1);
+    for (unsigned int i = 0; i < slots.size(); i++)
+    {
+        glGenBuffers(1, &slots[i].pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, nullptr, GL_STREAM_READ);
+        slots[i].fence = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameCapture::~FrameCapture()
+{
+    flush();
+    for (unsigned int i = 0; i < slots.size(); i++)
+        glDeleteBuffers(1, &slots[i].pbo);
+}
+
+void FrameCapture::capture(const std::string& filename)
+{
+    Slot& slot = slots[head];
+    // the ring is full: the oldest readback has to be drained before its buffer is reused
+    if (slot.fence)
+        resolve(slot);
+
+    // row alignment
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    // with a pack buffer bound the last argument is an offset, so this returns immediately
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.filename = filename;
+    head = (head + 1) % slots.size();
+}
+
+void FrameCapture::flush()
+{
+    // resolve in submission order, starting from the oldest slot
+    for (unsigned int i = 0; i < slots.size(); i++)
+    {
+        Slot& slot = slots[(head + i) % slots.size()];
+        if (slot.fence)
+            resolve(slot);
+    }
+}
+
+void FrameCapture::resolve(Slot& slot)
+{
+    // the first wait flushes the command stream so the fence is guaranteed to signal
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(slot.fence, 0, 1000000000);
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    if (status == GL_WAIT_FAILED)
+    {
+        std::cout << "FrameCapture::resolve() :: failed to wait for " << slot.filename << std::endl;
+        return;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    unsigned char* data = (unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, width * height * 4, GL_MAP_READ_BIT);
+    if (data)
+    {
+        if (pWriter)
+        {
+            // copy out of the mapped buffer so the PBO can be reused right away; the encode happens off-thread
+            std::vector<unsigned char> pixels(data, data + width * height * 4);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            pWriter->submit(slot.filename, std::move(pixels), width, height, outWidth, outHeight);
+        }
+        else
+        {
+            writeScreenshot(slot.filename, data, width, height, outWidth, outHeight);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+    }
+    else
+    {
+        std::cout << "FrameCapture::resolve() :: failed to map pixel buffer." << std::endl;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
@@ -0,0 +1,48 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "writer.h"
+
+// Asynchronous framebuffer readback through a ring of pixel-pack buffers.
+// capture() only queues a glReadPixels into the next PBO and fences it, so the GPU keeps
+// rendering the following frames while the copy is in flight. A slot is mapped and written
+// out when the ring wraps around to it again, or when flush() is called.
+// If an ImageWriter is given, the encoding is handed to its worker threads.
+class FrameCapture
+{
+private:
+    struct Slot
+    {
+        unsigned int pbo;
+        GLsync fence;
+        std::string filename;
+    };
+
+    int width;
+    int height;
+    int outWidth;
+    int outHeight;
+    unsigned int head;
+    std::vector<Slot> slots;
+    ImageWriter* pWriter;
+
+    // wait for the slot's readback to finish and write the frame out
+    void resolve(Slot& slot);
+
+public:
+    FrameCapture(int width, int height, int outWidth, int outHeight, unsigned int depth = 3, ImageWriter* writer = nullptr);
+    ~FrameCapture();
+
+    // queue a readback of the currently bound read framebuffer
+    void capture(const std::string& filename);
+    // hand every pending frame to the writer (or write it out directly)
+    void flush();
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _CONTEXT_H_
+#define _CONTEXT_H_
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <cstring>
+
+// Headless OpenGL context for batch export on machines without a display.
+// Built with USE_EGL, this creates an EGL context on Mesa's surfaceless platform (falling back to
+// the default display with a 1x1 pbuffer); window is set to NULL. Without EGL it falls back to a
+// hidden GLFW window, which still needs a desktop session but never presents or waits for vsync.
+// Either way everything is rendered through the offscreen RenderTarget.
+bool initHeadlessGL(GLFWwindow** window);
+void terminateHeadlessGL();
+
+// global opengl state shared by the windowed and the headless contexts
+void configureGL();
+
+#endif
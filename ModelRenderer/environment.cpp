@@ -1,5 +1,79 @@
 #include "environment.h"
 
+static GLenum iblFormat = GL_RGB32F;
+
+void setIBLFormat(GLenum format)
+{
+    if (format != GL_RGB32F && format != GL_RGB16F && format != GL_R11F_G11F_B10F && format != GL_RGB9_E5)
+    {
+        std::cout << "Unsupported IBL format, using GL_RGB32F" << std::endl;
+        format = GL_RGB32F;
+    }
+    iblFormat = format;
+}
+
+GLenum getIBLFormat()
+{
+    return iblFormat;
+}
+
+// define every face of levels mips of the bound cubemap
+static void defineCubemap(GLenum format, unsigned int size, unsigned int levels)
+{
+    for (unsigned int level = 0; level < levels; level++)
+    {
+        GLsizei s = std::max(size >> level, 1u);
+        for (unsigned int i = 0; i < 6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, format, s, s, 0, GL_RGB, GL_FLOAT, nullptr);
+    }
+}
+
+// re-specify a cubemap rendered in GL_RGB16F in the final format. The texels go through a pixel
+// buffer, so they never leave the GPU; the sampling state of the texture is kept.
+static void packCubemap(unsigned int id, unsigned int size, unsigned int levels)
+{
+    if (iblFormat != GL_RGB9_E5)
+        return;
+
+    std::vector<size_t> offsets;
+    size_t bytes = 0;
+    for (unsigned int level = 0; level < levels; level++)
+    {
+        size_t s = std::max(size >> level, 1u);
+        for (unsigned int i = 0; i < 6; i++)
+        {
+            offsets.push_back(bytes);
+            bytes += s * s * 3 * sizeof(unsigned short);
+        }
+    }
+
+    unsigned int pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_COPY);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+    for (unsigned int level = 0; level < levels; level++)
+    {
+        for (unsigned int i = 0; i < 6; i++)
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGB, GL_HALF_FLOAT, (void*)offsets[level * 6 + i]);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int level = 0; level < levels; level++)
+    {
+        GLsizei s = std::max(size >> level, 1u);
+        for (unsigned int i = 0; i < 6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGB9_E5, s, s, 0, GL_RGB, GL_HALF_FLOAT, (void*)offsets[level * 6 + i]);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
+}
+
 Cubemap::Cubemap()
 {
     
@@ -11,34 +85,42 @@ Cubemap::Cubemap(const char* vert, const char* frag)
     glGenRenderbuffers(1, &rbo);
     glGenTextures(1, &hdr);
     glGenTextures(1, &id);
+    size = 256;
+    levels = 1;
+    while ((size >> levels) > 0)
+        levels++;
 
     pShader = new Shader(vert, frag);
     setupMatrices();
 }
 
-void Cubemap::loadHDR(const char* fname)
+// upload an already decoded equirectangular image (RGB floats, flipped) as the HDR source
+void Cubemap::setHDR(const float* data, int width, int height)
 {
-    stbi_set_flip_vertically_on_load(true);
-    int width, height, nrComponents;
-    float* data = stbi_loadf(fname, &width, &height, &nrComponents, 0);
-
-    if (data)
-    {
-        glBindTexture(GL_TEXTURE_2D, hdr);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT, data);
+    // stage the pixels in a pixel-unpack buffer, so the driver converts and uploads them from there
+    // instead of copying the client memory during the call; fall back to a plain upload
+    size_t bytes = (size_t)width * height * 3 * sizeof(float);
+    unsigned int pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst)
+        memcpy(dst, data, bytes);
+    bool staged = dst && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    if (!staged)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, hdr);
+    // with the buffer bound, a null pointer is offset 0 into it
+    glTexImage2D(GL_TEXTURE_2D, 0, iblFormat, width, height, 0, GL_RGB, GL_FLOAT, staged ? nullptr : data);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
 
-        stbi_image_free(data);
-        std::cout << fname << " loaded" << std::endl;
-    }
-    else
-    {
-        std::cout << "Failed to load HDR image." << std::endl;
-    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
 void Cubemap::loadEnvfromDirectory(std::string path, std::vector<std::string> &files, std::vector<std::string>& name, int& count)
@@ -72,10 +154,25 @@ void Cubemap::setupMatrices()
     views[5] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f, 0.0f,-1.0f), glm::vec3(0.0f,-1.0f, 0.0f));
 }
 
+// setup the cubemap storage that create() renders into
+void Cubemap::allocate(bool render)
+{
+    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+    // every level is defined up front: GL_RGB9_E5 can't have mipmaps generated for it
+    defineCubemap(render && iblFormat == GL_RGB9_E5 ? GL_RGB16F : iblFormat, size, levels);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    // the prefilter pass reads the mips for filtered importance sampling
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
 // convert HDR equirectangular environment map to cubemap equivalent
 void Cubemap::create()
 {
-    GLsizei CS = 256;
+    GLsizei CS = size;
     glBindFramebuffer(GL_FRAMEBUFFER, fbo);
     glBindRenderbuffer(GL_RENDERBUFFER, rbo);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, CS, CS);
@@ -84,16 +181,7 @@ void Cubemap::create()
     //loadHDR("../../img/envs/Newport_Loft/Newport_Loft_Ref.hdr");
 
     // setup cubemap to render to and attach to framebuffer
-    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
-    for (unsigned int i = 0; i < 6; i++)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB32F, CS, CS, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    allocate(true);
 
     pShader->use();
     pShader->setInt("equirectangularMap", 0);
@@ -112,6 +200,21 @@ void Cubemap::create()
         cube.render();
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    packCubemap(id, size, levels);
+}
+
+void Cubemap::upload(const float* faces)
+{
+    allocate(true);
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, size, size, GL_RGB, GL_FLOAT, faces + (size_t)i * size * size * 3);
+    }
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    packCubemap(id, size, levels);
 }
 
 
@@ -120,25 +223,37 @@ Irradiancemap::Irradiancemap(const char* vert, const char* frag, Cubemap* p)
     // init
     pShader = new Shader(vert, frag);
     glGenTextures(1, &id);
+    size = 128;
     // set-ups
     pCubemap = p;
     //create();
 }
 
-// create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
-void Irradiancemap::create()
+void Irradiancemap::allocate(bool render)
 {
-    GLsizei IS = 128;
     glBindTexture(GL_TEXTURE_CUBE_MAP, id);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB32F, IS, IS, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
+    defineCubemap(render && iblFormat == GL_RGB9_E5 ? GL_RGB16F : iblFormat, size, 1);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void Irradiancemap::upload(const float* faces)
+{
+    allocate();
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, size, size, GL_RGB, GL_FLOAT, faces + (size_t)i * size * size * 3);
+    }
+}
+
+// create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
+void Irradiancemap::create()
+{
+    GLsizei IS = size;
+    allocate(true);
 
     glBindFramebuffer(GL_FRAMEBUFFER, pCubemap->getFBO());
     glBindRenderbuffer(GL_RENDERBUFFER, pCubemap->getRBO());
@@ -161,43 +276,59 @@ void Irradiancemap::create()
         cube.render();
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    packCubemap(id, size, 1);
 }
 
 Prefilteredmap::Prefilteredmap(const char* vert, const char* frag, Cubemap* p)
 {
     pShader = new Shader(vert, frag);
     glGenTextures(1, &id);
+    size = 128;
+    levels = 5;
+    samples = 1024;
 
     pCubemap = p;
     //create();
 }
 
-// create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
-void Prefilteredmap::create()
+void Prefilteredmap::allocate(bool render)
 {
-    GLsizei PS = 128;
     glBindTexture(GL_TEXTURE_CUBE_MAP, id);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB32F, PS, PS, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
+    // define every mip level so OpenGL allocates the required memory
+    defineCubemap(render && iblFormat == GL_RGB9_E5 ? GL_RGB16F : iblFormat, size, levels);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // be sure to set minifcation filter to mip_linear 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // generate mipmaps for the cubemap so OpenGL automatically allocates the required memory.
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+}
+
+unsigned int Prefilteredmap::getSampleCount(unsigned int mip) const
+{
+    // roughness 0 is a mirror: every GGX sample is the reflection vector itself
+    if (mip == 0 || levels < 2)
+        return 1;
+    float roughness = (float)mip / (float)(levels - 1);
+    return std::max(16u, (unsigned int)(samples * roughness));
+}
+
+// create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
+void Prefilteredmap::create()
+{
+    GLsizei PS = size;
+    allocate(true);
 
     // run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
     pShader->use();
     pShader->setInt("environmentMap", 0);
     pShader->setMat4("projection", pCubemap->getProjection());
+    pShader->setFloat("resolution", (float)pCubemap->getSize());
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, pCubemap->getID());
 
     glBindFramebuffer(GL_FRAMEBUFFER, pCubemap->getFBO());
-    unsigned int maxMipLevels = 5;
+    unsigned int maxMipLevels = levels;
     for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
     {
         // reisze framebuffer according to mip-level size.
@@ -209,6 +340,7 @@ void Prefilteredmap::create()
 
         float roughness = (float)mip / (float)(maxMipLevels - 1);
         pShader->setFloat("roughness", roughness);
+        pShader->setInt("sampleCount", getSampleCount(mip));
         for (unsigned int i = 0; i < 6; ++i)
         {
             pShader->setMat4("view", pCubemap->getViews(i));
@@ -219,34 +351,45 @@ void Prefilteredmap::create()
         }
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    packCubemap(id, size, levels);
 }
 
-BRDFmap::BRDFmap(const char* vert, const char* frag, Cubemap* p)
+BRDFmap::BRDFmap(const char* vert, const char* frag)
 {
     pShader = new Shader(vert, frag);
     glGenTextures(1, &id);
-
-    pCubemap = p;
-    //create();
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &rbo);
+    size = 256;
+    created = false;
 }
 
-// create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
-void BRDFmap::create()
+void BRDFmap::allocate()
 {
-    GLsizei BS = 256;
     // pre-allocate enough memory for the LUT texture.
     glBindTexture(GL_TEXTURE_2D, id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, BS, BS, 0, GL_RG, GL_FLOAT, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, iblFormat == GL_RGB32F ? GL_RG32F : GL_RG16F, size, size, 0, GL_RG, GL_FLOAT, 0);
     // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// render the BRDF integration LUT with a screen-space quad.
+void BRDFmap::create()
+{
+    if (created)
+        return;
+
+    GLsizei BS = size;
+    allocate();
 
     // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-    glBindFramebuffer(GL_FRAMEBUFFER, pCubemap->getFBO());
-    glBindRenderbuffer(GL_RENDERBUFFER, pCubemap->getRBO());
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, BS, BS);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, id, 0);
 
     glViewport(0, 0, BS, BS);
@@ -255,4 +398,43 @@ void BRDFmap::create()
     quad.render();
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
\ No newline at end of file
+    created = true;
+}
+
+bool BRDFmap::load(const char* fname)
+{
+    std::ifstream fin(fname, std::ios::in | std::ios::binary);
+    if (!fin)
+        return false;
+
+    std::vector<unsigned short> texels(size * size * 2);
+    fin.read((char*)texels.data(), texels.size() * sizeof(unsigned short));
+    // a LUT baked at another size is not usable
+    if (!fin || fin.peek() != EOF)
+    {
+        std::cout << "Failed to load BRDF LUT " << fname << std::endl;
+        return false;
+    }
+
+    allocate();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RG, GL_HALF_FLOAT, texels.data());
+    created = true;
+    std::cout << fname << " loaded" << std::endl;
+    return true;
+}
+
+bool BRDFmap::save(const char* fname)
+{
+    if (!created)
+        return false;
+
+    std::vector<unsigned short> texels(size * size * 2);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_HALF_FLOAT, texels.data());
+
+    std::ofstream fout(fname, std::ios::out | std::ios::binary);
+    fout.write((const char*)texels.data(), texels.size() * sizeof(unsigned short));
+    return (bool)fout;
+}
@@ -4,15 +4,24 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include "stb_image.h"
+#include "imageload.h"
 #include <iostream>
 #include <vector>
 #include <fstream>
 #include <string>
+#include <cstring>
 #include <filesystem>
+#include <algorithm>
 
 #include "shader.h"
 #include "polygon.h"
+#include "hdrloader.h"
+
+// Internal format of the IBL cubemaps and the HDR source: GL_RGB32F (default), GL_RGB16F,
+// GL_R11F_G11F_B10F or GL_RGB9_E5. GL_RGB9_E5 is not color renderable, so the passes render in
+// GL_RGB16F and pack the result afterwards. The BRDF LUT is GL_RG16F for every format but GL_RGB32F.
+void setIBLFormat(GLenum format);
+GLenum getIBLFormat();
 
 class Cubemap
 {
@@ -21,6 +30,8 @@ private:
     unsigned int hdr;
     unsigned int fbo;
     unsigned int rbo;
+    unsigned int size;
+    unsigned int levels;
     glm::mat4 projection;
     glm::mat4 views[6];
     std::vector<std::string> list;
@@ -32,15 +43,22 @@ public:
     Cubemap();
     Cubemap(const char* vert, const char* frag);
 
-    void loadHDR(const char* fname);
+    void setHDR(const float* data, int width, int height);
     void loadEnvfromDirectory(std::string path, std::vector<std::string>& files, std::vector<std::string>& name, int& count);
     // deprived
     //void loadEnvList(std::string path, std::string listname);
     //void loadHDRfromList(std::string path, int idx);
     void setupMatrices();
+    // define the cubemap storage (full mip chain) and sampling state without filling it;
+    // render selects a format the passes can draw into
+    void allocate(bool render = false);
     void create();
+    // fill the cubemap with faces computed on the CPU (see precompute.h)
+    void upload(const float* faces);
 
     unsigned int getID() const { return id; }
+    unsigned int getSize() const { return size; }
+    unsigned int getLevels() const { return levels; }
     unsigned int getHDR() const { return hdr; }
     unsigned int getFBO() const { return fbo; }
     unsigned int getRBO() const { return rbo; }
@@ -54,13 +72,18 @@ class Irradiancemap
 {
 private:
     unsigned int id;
+    unsigned int size;
     Cubemap* pCubemap;
     Cube cube;
 
 public:
     Irradiancemap(const char* vert, const char* frag, Cubemap* p);
     unsigned int getID() const { return id; }
+    unsigned int getSize() const { return size; }
+    void allocate(bool render = false);
     void create();
+    // fill the map with faces computed on the CPU (see precompute.h)
+    void upload(const float* faces);
     Shader* pShader;
 };
 
@@ -68,27 +91,49 @@ class Prefilteredmap
 {
 private:
     unsigned int id;
+    unsigned int size;
+    unsigned int levels;
+    unsigned int samples;
     Cubemap* pCubemap;
     Cube cube;
 
 public:
     Prefilteredmap(const char* vert, const char* frag, Cubemap* p);
     unsigned int getID() const { return id; }
+    unsigned int getSize() const { return size; }
+    unsigned int getLevels() const { return levels; }
+    // GGX samples taken per texel at the roughest level; smoother levels take fewer, since the
+    // lobe is narrower and the filtered lookups into the cubemap mips hide the rest of the noise
+    void setSampleCount(unsigned int count) { samples = count; }
+    unsigned int getSampleCount(unsigned int mip) const;
+    void allocate(bool render = false);
     void create();
     Shader* pShader;
 };
 
+// The split-sum BRDF integration LUT doesn't depend on the environment, so it has its own
+// framebuffer and is generated (or loaded from a baked RG16F file) once per process.
 class BRDFmap
 {
 private:
     unsigned int id;
-    Cubemap* pCubemap;
+    unsigned int fbo;
+    unsigned int rbo;
+    unsigned int size;
+    bool created;
     Quad quad;
 
+    void allocate();
+
 public:
-    BRDFmap(const char* vert, const char* frag, Cubemap* p);
+    BRDFmap(const char* vert, const char* frag);
     unsigned int getID() const { return id; }
+    unsigned int getSize() const { return size; }
+    // render the LUT; does nothing once the LUT exists
     void create();
+    // load/save the LUT as raw RG16F texels, size x size
+    bool load(const char* fname);
+    bool save(const char* fname);
     Shader* pShader;
 };
 
@@ -0,0 +1,60 @@
+#include "envloader.h"
+
+EnvLoader::EnvLoader(IBLCache* cache, unsigned int ahead)
+{
+    pCache = cache;
+    this->ahead = ahead;
+}
+
+EnvLoader::~EnvLoader()
+{
+    // the futures of std::async join their threads on destruction
+    jobs.clear();
+}
+
+EnvImage EnvLoader::read(const std::string& path, IBLCache* cache, bool decode)
+{
+    EnvImage env;
+    env.path = path;
+    env.hash = 0;
+    env.width = 0;
+    env.height = 0;
+    if (cache && cache->enabled())
+    {
+        env.hash = IBLCache::hashFile(path);
+        if (!decode && cache->contains(env.hash))
+            return env;
+    }
+    loadEquirect(path.c_str(), env.rgb, env.width, env.height);
+    return env;
+}
+
+void EnvLoader::prefetch(const std::string& path)
+{
+    if (ahead == 0 || jobs.size() >= ahead)
+        return;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        if (jobs[i].path == path)
+            return;
+    }
+
+    Job job;
+    job.path = path;
+    job.result = std::async(std::launch::async, read, path, pCache, false);
+    jobs.push_back(std::move(job));
+}
+
+EnvImage EnvLoader::take(const std::string& path)
+{
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        if (jobs[i].path == path)
+        {
+            EnvImage env = jobs[i].result.get();
+            jobs.erase(jobs.begin() + i);
+            return env;
+        }
+    }
+    return read(path, pCache, false);
+}
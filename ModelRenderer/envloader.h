@@ -0,0 +1,53 @@
+#ifndef _ENVLOADER_H_
+#define _ENVLOADER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <iostream>
+
+#include "iblcache.h"
+#include "precompute.h"
+
+// a decoded equirectangular environment, ready to upload
+struct EnvImage
+{
+    std::string path;
+    unsigned long long hash;    // IBL cache key, 0 without a cache
+    std::vector<float> rgb;     // empty when not decoded
+    int width;
+    int height;
+};
+
+// Decodes the next environments on background threads while the current one renders, so an
+// environment switch only costs the upload. Environments that already have an IBL cache entry
+// are only hashed, since the maps come from the cache and the image is never needed.
+class EnvLoader
+{
+private:
+    struct Job
+    {
+        std::string path;
+        std::future<EnvImage> result;
+    };
+
+    IBLCache* pCache;
+    unsigned int ahead;
+    std::deque<Job> jobs;
+
+public:
+    // ahead is the number of environments decoded in advance
+    EnvLoader(IBLCache* cache, unsigned int ahead = 1);
+    ~EnvLoader();
+
+    // hash and decode an image; decode == false skips the decode if the cache has an entry
+    static EnvImage read(const std::string& path, IBLCache* cache, bool decode);
+
+    // start decoding the image in the background, unless it is already queued or too many are
+    void prefetch(const std::string& path);
+    // the image of the path, waiting for its prefetch or reading it on the spot if there was none
+    EnvImage take(const std::string& path);
+};
+
+#endif
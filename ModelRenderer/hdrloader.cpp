@@ -0,0 +1,235 @@
+#include "hdrloader.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDRLOADER_SSE
+#include <emmintrin.h>
+#endif
+
+HDRImage::HDRImage()
+{
+    width = 0;
+    height = 0;
+}
+
+bool HDRImage::open(const char* fname)
+{
+    width = 0;
+    height = 0;
+    rows.clear();
+    if (!file.open(fname))
+        return false;
+
+    size_t pos = 0;
+    if (!parseHeader(pos) || !findRows(pos))
+    {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool HDRImage::parseHeader(size_t& pos)
+{
+    const char* text = (const char*)file.getData();
+    size_t size = file.getSize();
+
+    // one header line at a time, up to the blank line that ends the header
+    auto readLine = [&](std::string& line) {
+        size_t end = pos;
+        while (end < size && text[end] != '\n')
+            end++;
+        if (end >= size)
+            return false;
+        line.assign(text + pos, end - pos);
+        pos = end + 1;
+        return true;
+    };
+
+    std::string line;
+    if (!readLine(line) || (line != "#?RADIANCE" && line != "#?RGBE"))
+        return false;
+    bool rgbe = false;
+    while (true)
+    {
+        if (!readLine(line))
+            return false;
+        if (line.empty())
+            break;
+        if (line == "FORMAT=32-bit_rle_rgbe")
+            rgbe = true;
+    }
+    if (!rgbe)
+        return false;
+
+    // resolution string; flipped or transposed layouts are left to stbi
+    if (!readLine(line))
+        return false;
+    char ySign, xSign, yAxis, xAxis;
+    if (sscanf(line.c_str(), "%c%c %d %c%c %d", &ySign, &yAxis, &height, &xSign, &xAxis, &width) != 6)
+        return false;
+    if (ySign != '-' || yAxis != 'Y' || xSign != '+' || xAxis != 'X' || width <= 0 || height <= 0)
+        return false;
+    return true;
+}
+
+// walk the run lengths of every scanline to find where each one starts
+bool HDRImage::findRows(size_t pos)
+{
+    const unsigned char* data = file.getData();
+    size_t size = file.getSize();
+    rows.resize(height);
+    bool rle = width >= 8 && width < 32768;
+    for (int y = 0; y < height; y++)
+    {
+        rows[y] = pos;
+        if (pos + 4 > size)
+            return false;
+        const unsigned char* p = data + pos;
+        if (!rle || p[0] != 2 || p[1] != 2 || (p[2] & 0x80))
+        {
+            // flat scanline; old-style RLE can't be told apart without decoding, so leave it to stbi
+            if (p[0] == 1 && p[1] == 1 && p[2] == 1)
+                return false;
+            pos += (size_t)width * 4;
+            continue;
+        }
+        if (((p[2] << 8) | p[3]) != width)
+            return false;
+        pos += 4;
+        for (int c = 0; c < 4; c++)
+        {
+            int x = 0;
+            while (x < width)
+            {
+                if (pos >= size)
+                    return false;
+                int count = data[pos++];
+                if (count > 128)
+                {
+                    count -= 128;
+                    pos++;
+                }
+                else
+                {
+                    if (count == 0)
+                        return false;
+                    pos += count;
+                }
+                x += count;
+            }
+            if (x != width)
+                return false;
+        }
+    }
+    return pos <= size;
+}
+
+// RGBE to float as stbi does: m * 2^(e - 136), and 0 when e is 0
+static inline void convertScalar(const unsigned char* rgbe, float* dst)
+{
+    if (rgbe[3] == 0)
+    {
+        dst[0] = dst[1] = dst[2] = 0.0f;
+        return;
+    }
+    float scale = (float)ldexp(1.0, rgbe[3] - 136);
+    dst[0] = rgbe[0] * scale;
+    dst[1] = rgbe[1] * scale;
+    dst[2] = rgbe[2] * scale;
+}
+
+static void convertRow(const unsigned char* rgbe, float* dst, int width)
+{
+    int x = 0;
+#ifdef HDRLOADER_SSE
+    // four pixels per iteration. The scale 2^(e - 128) is built directly in the exponent bits
+    // and the 1/256 is folded into the multiply. Each pixel is stored as 4 floats and the next
+    // pixel overwrites the 4th, so the last pixel of the row is left to the scalar path.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 inv256 = _mm_set1_ps(1.0f / 256.0f);
+    for (; x + 4 < width; x += 4)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(rgbe + x * 4));
+        __m128i lo16 = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi16 = _mm_unpackhi_epi8(bytes, zero);
+        __m128i px[4] = {
+            _mm_unpacklo_epi16(lo16, zero), _mm_unpackhi_epi16(lo16, zero),
+            _mm_unpacklo_epi16(hi16, zero), _mm_unpackhi_epi16(hi16, zero)
+        };
+        for (int i = 0; i < 4; i++)
+        {
+            // broadcast the exponent of the pixel
+            __m128i e = _mm_shuffle_epi32(px[i], _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i bits = _mm_slli_epi32(_mm_sub_epi32(e, _mm_set1_epi32(1)), 23);
+            __m128 scale = _mm_and_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(_mm_cmpgt_epi32(e, zero)));
+            __m128 value = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(px[i]), inv256), scale);
+            _mm_storeu_ps(dst + (x + i) * 3, value);
+        }
+    }
+#endif
+    for (; x < width; x++)
+        convertScalar(rgbe + x * 4, dst + x * 3);
+}
+
+bool HDRImage::decodeRow(int y, unsigned char* rgbe, float* dst) const
+{
+    const unsigned char* data = file.getData();
+    const unsigned char* p = data + rows[y];
+    bool rle = width >= 8 && width < 32768 && p[0] == 2 && p[1] == 2 && !(p[2] & 0x80);
+    if (!rle)
+    {
+        convertRow(p, dst, width);
+        return true;
+    }
+
+    // new-style RLE stores the four channels one after the other; interleave them into rgbe
+    p += 4;
+    for (int c = 0; c < 4; c++)
+    {
+        int x = 0;
+        while (x < width)
+        {
+            int count = *p++;
+            if (count > 128)
+            {
+                count -= 128;
+                unsigned char value = *p++;
+                for (int i = 0; i < count; i++)
+                    rgbe[(x + i) * 4 + c] = value;
+            }
+            else
+            {
+                for (int i = 0; i < count; i++)
+                    rgbe[(x + i) * 4 + c] = p[i];
+                p += count;
+            }
+            x += count;
+        }
+    }
+    convertRow(rgbe, dst, width);
+    return true;
+}
+
+bool HDRImage::decode(float* dst, unsigned int threads) const
+{
+    if (rows.empty())
+        return false;
+    parallelFor(height, [&](int y) {
+        thread_local std::vector<unsigned char> rgbe;
+        rgbe.resize((size_t)width * 4);
+        // the file is top row first
+        decodeRow(y, rgbe.data(), dst + (size_t)(height - 1 - y) * width * 3);
+    }, threads);
+    return true;
+}
+
+bool loadHDRFile(const char* fname, std::vector<float>& rgb, int& width, int& height)
+{
+    HDRImage image;
+    if (!image.open(fname))
+        return false;
+    width = image.getWidth();
+    height = image.getHeight();
+    rgb.resize((size_t)width * height * 3);
+    return image.decode(rgb.data());
+}
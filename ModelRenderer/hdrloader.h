@@ -0,0 +1,48 @@
+#ifndef _HDRLOADER_H_
+#define _HDRLOADER_H_
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+
+#include "parallel.h"
+#include "mappedfile.h"
+
+// Radiance RGBE (.hdr) reader. The file is memory mapped, the scanline offsets are found in one
+// sequential pass over the run lengths, then the scanlines are decoded in parallel and converted
+// to floats four pixels at a time with SSE2. Only the usual "-Y height +X width" layout with
+// new-style RLE or flat scanlines is handled; open() fails on anything else so callers can fall
+// back to stbi_loadf.
+class HDRImage
+{
+private:
+    MappedFile file;
+    int width;
+    int height;
+    // start of every scanline in the file, top row first
+    std::vector<size_t> rows;
+
+    bool parseHeader(size_t& pos);
+    bool findRows(size_t pos);
+    bool decodeRow(int y, unsigned char* rgbe, float* dst) const;
+
+public:
+    HDRImage();
+
+    bool open(const char* fname);
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // decode into width * height RGB floats, bottom row first as OpenGL (and a flipped
+    // stbi_loadf) expects. dst may be a mapped pixel-unpack buffer.
+    bool decode(float* dst, unsigned int threads = 0) const;
+};
+
+// open and decode a .hdr file into RGB floats, bottom row first
+bool loadHDRFile(const char* fname, std::vector<float>& rgb, int& width, int& height);
+
+#endif
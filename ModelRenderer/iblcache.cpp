@@ -0,0 +1,245 @@
+#include "iblcache.h"
+
+static const char CACHE_MAGIC[4] = { 'I', 'B', 'L', 'C' };
+static const unsigned int CACHE_VERSION = 5;
+
+struct CacheHeader
+{
+    char magic[4];
+    unsigned int version;
+    unsigned long long hash;
+    unsigned int count;
+    unsigned int prefilterSamples;  // GGX samples of the roughest prefilter level
+    unsigned int cpuPrecompute;     // cubemap and irradiance built by precompute.h
+    unsigned int format;            // IBL_FORMAT the maps were stored in, lossy for the packed ones
+};
+
+struct CacheRecord
+{
+    unsigned int size;
+    unsigned int levels;
+};
+
+// spherical harmonics irradiance, zero when the entry has an irradiance map instead
+struct CacheSH
+{
+    float coeffs[9 * 3];
+};
+
+IBLCache::IBLCache(const std::string& directory, bool cpuPrecompute)
+{
+    this->directory = directory;
+    this->cpuPrecompute = cpuPrecompute;
+    if (!directory.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+    }
+}
+
+unsigned long long IBLCache::hashFile(const std::string& path)
+{
+    std::ifstream fin(path, std::ios::in | std::ios::binary);
+    if (!fin)
+        return 0;
+
+    unsigned long long hash = 14695981039346656037ull;
+    std::vector<char> buffer(1 << 20);
+    while (fin)
+    {
+        fin.read(buffer.data(), buffer.size());
+        std::streamsize n = fin.gcount();
+        for (std::streamsize i = 0; i < n; i++)
+        {
+            hash ^= (unsigned char)buffer[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+std::string IBLCache::entryPath(unsigned long long hash) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ibl", hash);
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool IBLCache::contains(unsigned long long hash) const
+{
+    std::error_code ec;
+    return enabled() && hash != 0 && std::filesystem::exists(entryPath(hash), ec);
+}
+
+unsigned int IBLCache::prefilterSamples(const Prefilteredmap* prefiltered)
+{
+    return prefiltered->getSampleCount(prefiltered->getLevels() - 1);
+}
+
+// bytes of one face of a RGB half float mip level
+size_t IBLCache::levelBytes(unsigned int size, unsigned int level)
+{
+    size_t s = size >> level;
+    if (s == 0)
+        s = 1;
+    return s * s * 3 * sizeof(unsigned short);
+}
+
+bool IBLCache::load(unsigned long long hash, Cubemap* cubemap, Irradiancemap* irradiance, Prefilteredmap* prefiltered, glm::vec3* sh)
+{
+    if (!enabled() || hash == 0)
+        return false;
+
+    std::ifstream fin(entryPath(hash), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!fin)
+        return false;
+    std::vector<char> file((size_t)fin.tellg());
+    fin.seekg(0);
+    fin.read(file.data(), file.size());
+    if (!fin)
+        return false;
+
+    // an entry without irradiance map has an empty record for it
+    Entry entries[3] = {
+        { cubemap->getID(), cubemap->getSize(), cubemap->getLevels() },
+        { irradiance ? irradiance->getID() : 0, irradiance ? irradiance->getSize() : 0, irradiance ? 1u : 0u },
+        { prefiltered->getID(), prefiltered->getSize(), prefiltered->getLevels() }
+    };
+
+    // the entry must match the hash, the way the maps are built and the current map dimensions exactly
+    size_t offset = sizeof(CacheHeader) + 3 * sizeof(CacheRecord) + sizeof(CacheSH);
+    if (file.size() < offset)
+        return false;
+    const CacheHeader* header = (const CacheHeader*)file.data();
+    const CacheRecord* records = (const CacheRecord*)(file.data() + sizeof(CacheHeader));
+    if (memcmp(header->magic, CACHE_MAGIC, 4) != 0 || header->version != CACHE_VERSION || header->hash != hash || header->count != 3)
+        return false;
+    if (header->prefilterSamples != prefilterSamples(prefiltered) || header->cpuPrecompute != (cpuPrecompute ? 1u : 0u) ||
+        header->format != (unsigned int)getIBLFormat())
+        return false;
+    size_t dataBytes = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (records[i].size != entries[i].size || records[i].levels != entries[i].levels)
+            return false;
+        for (unsigned int level = 0; level < entries[i].levels; level++)
+            dataBytes += 6 * levelBytes(entries[i].size, level);
+    }
+    if (file.size() != offset + dataBytes)
+        return false;
+
+    if (sh)
+    {
+        const CacheSH* coeffs = (const CacheSH*)(file.data() + sizeof(CacheHeader) + 3 * sizeof(CacheRecord));
+        for (int k = 0; k < 9; k++)
+            sh[k] = glm::vec3(coeffs->coeffs[k * 3], coeffs->coeffs[k * 3 + 1], coeffs->coeffs[k * 3 + 2]);
+    }
+
+    // allocate the textures the same way create() does, then fill them from one upload buffer
+    cubemap->allocate();
+    if (irradiance)
+        irradiance->allocate();
+    prefiltered->allocate();
+
+    unsigned int pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, dataBytes, file.data() + offset, GL_STREAM_DRAW);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    size_t pos = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, entries[i].id);
+        for (unsigned int level = 0; level < entries[i].levels; level++)
+        {
+            GLsizei s = std::max(entries[i].size >> level, 1u);
+            for (unsigned int face = 0; face < 6; face++)
+            {
+                glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, s, s, GL_RGB, GL_HALF_FLOAT, (void*)pos);
+                pos += levelBytes(entries[i].size, level);
+            }
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
+    return true;
+}
+
+bool IBLCache::save(unsigned long long hash, Cubemap* cubemap, Irradiancemap* irradiance, Prefilteredmap* prefiltered, const glm::vec3* sh)
+{
+    if (!enabled() || hash == 0)
+        return false;
+
+    // an entry without irradiance map has an empty record for it
+    Entry entries[3] = {
+        { cubemap->getID(), cubemap->getSize(), cubemap->getLevels() },
+        { irradiance ? irradiance->getID() : 0, irradiance ? irradiance->getSize() : 0, irradiance ? 1u : 0u },
+        { prefiltered->getID(), prefiltered->getSize(), prefiltered->getLevels() }
+    };
+
+    // zeroed, so no uninitialized padding reaches the file
+    CacheHeader header = {};
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.hash = hash;
+    header.count = 3;
+    header.prefilterSamples = prefilterSamples(prefiltered);
+    header.cpuPrecompute = cpuPrecompute ? 1u : 0u;
+    header.format = (unsigned int)getIBLFormat();
+    CacheRecord records[3];
+    size_t dataBytes = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        records[i].size = entries[i].size;
+        records[i].levels = entries[i].levels;
+        for (unsigned int level = 0; level < entries[i].levels; level++)
+            dataBytes += 6 * levelBytes(entries[i].size, level);
+    }
+    CacheSH coeffs;
+    for (int k = 0; k < 9; k++)
+    {
+        for (int c = 0; c < 3; c++)
+            coeffs.coeffs[k * 3 + c] = sh ? sh[k][c] : 0.0f;
+    }
+
+    // let the driver convert to half floats while reading back
+    std::vector<char> data(dataBytes);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    size_t pos = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, entries[i].id);
+        for (unsigned int level = 0; level < entries[i].levels; level++)
+        {
+            for (unsigned int face = 0; face < 6; face++)
+            {
+                glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_HALF_FLOAT, data.data() + pos);
+                pos += levelBytes(entries[i].size, level);
+            }
+        }
+    }
+
+    // write to a temporary file and rename it, so concurrent jobs never see a partial entry
+    std::string path = entryPath(hash);
+    std::string temp = tempPath(path);
+    std::ofstream fout(temp, std::ios::out | std::ios::binary);
+    fout.write((const char*)&header, sizeof(header));
+    fout.write((const char*)records, sizeof(records));
+    fout.write((const char*)&coeffs, sizeof(coeffs));
+    fout.write(data.data(), data.size());
+    fout.close();
+    if (!fout)
+    {
+        std::cout << "Failed to write IBL cache entry " << path << std::endl;
+        std::filesystem::remove(temp);
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec)
+        std::filesystem::remove(temp, ec);
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef _IBLCACHE_H_
+#define _IBLCACHE_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include "environment.h"
+#include "tempfile.h"
+
+// On-disk cache of the precomputed IBL maps of an environment, keyed by a hash of the HDR file.
+// An entry holds the environment cubemap, the irradiance map and the prefiltered map as half
+// floats, every mip level of every face, and is uploaded with a single pixel-unpack buffer.
+// The irradiance map may be replaced by 9 spherical harmonics coefficients (IBL_SH_IRRADIANCE).
+// Entries are only used when they were built with the same prefilter sample count, precompute path
+// and texture format.
+class IBLCache
+{
+private:
+    // one cubemap texture as stored in an entry
+    struct Entry
+    {
+        unsigned int id;
+        unsigned int size;
+        unsigned int levels;
+    };
+
+    std::string directory;
+    bool cpuPrecompute;
+
+    std::string entryPath(unsigned long long hash) const;
+    static size_t levelBytes(unsigned int size, unsigned int level);
+    static unsigned int prefilterSamples(const Prefilteredmap* prefiltered);
+
+public:
+    // cpuPrecompute: the cubemap and irradiance map come from precompute.h (IBL_CPU_PRECOMPUTE),
+    // so entries made by the GL passes don't match and vice versa
+    IBLCache(const std::string& directory, bool cpuPrecompute = false);
+
+    // 64-bit FNV-1a over the file contents; returns 0 if the file can't be read
+    static unsigned long long hashFile(const std::string& path);
+
+    // whether an entry exists for the hash (it may still not match the current map sizes)
+    bool contains(unsigned long long hash) const;
+    // fill the maps from the cache entry of the hash; false if there is no usable entry.
+    // irradiance is NULL when the SH coefficients are used instead, then sh receives them.
+    bool load(unsigned long long hash, Cubemap* cubemap, Irradiancemap* irradiance, Prefilteredmap* prefiltered, glm::vec3* sh = NULL);
+    // read the maps back and store them as the cache entry of the hash
+    bool save(unsigned long long hash, Cubemap* cubemap, Irradiancemap* irradiance, Prefilteredmap* prefiltered, const glm::vec3* sh = NULL);
+
+    bool enabled() const { return !directory.empty(); }
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "imageload.h"
+
+#include <cstring>
+#include <vector>
+
+void flipRows(void* data, int width, int height, size_t pixelBytes)
+{
+    size_t rowBytes = (size_t)width * pixelBytes;
+    std::vector<unsigned char> row(rowBytes);
+    unsigned char* bytes = (unsigned char*)data;
+    for (int y = 0; y < height / 2; y++)
+    {
+        unsigned char* top = bytes + (size_t)y * rowBytes;
+        unsigned char* bottom = bytes + (size_t)(height - 1 - y) * rowBytes;
+        memcpy(row.data(), top, rowBytes);
+        memcpy(top, bottom, rowBytes);
+        memcpy(bottom, row.data(), rowBytes);
+    }
+}
+
+unsigned char* loadImage(const char* fname, int* width, int* height, int* components, int desired, bool flip)
+{
+    unsigned char* data = stbi_load(fname, width, height, components, desired);
+    if (data && flip)
+        flipRows(data, *width, *height, desired ? desired : *components);
+    return data;
+}
+
+float* loadImagef(const char* fname, int* width, int* height, int* components, int desired, bool flip)
+{
+    float* data = stbi_loadf(fname, width, height, components, desired);
+    if (data && flip)
+        flipRows(data, *width, *height, (desired ? desired : *components) * sizeof(float));
+    return data;
+}
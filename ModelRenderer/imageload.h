@@ -0,0 +1,21 @@
+#ifndef _IMAGELOAD_H_
+#define _IMAGELOAD_H_
+
+#include <cstddef>
+
+#include "stb_image.h"
+
+// stb_image keeps its flip-on-load setting in a plain global, so images decoded on several threads
+// would race on it. These wrappers leave that global at its default (no flip) and flip the rows of
+// the decoded image themselves, so every caller states the orientation it wants. Nothing else may
+// call stbi_set_flip_vertically_on_load. Free the result with stbi_image_free.
+
+// 8 bits per channel; flip puts the bottom row first, the way GL textures start
+unsigned char* loadImage(const char* fname, int* width, int* height, int* components, int desired, bool flip);
+// float channels, for HDR images
+float* loadImagef(const char* fname, int* width, int* height, int* components, int desired, bool flip);
+
+// swap the rows of an image top to bottom in place
+void flipRows(void* data, int width, int height, size_t pixelBytes);
+
+#endif
@@ -1,10 +1,41 @@
 #include "main.h"
+#include <algorithm>
 
 int main(int argc, char* argv[])
 {
+	// offline preprocessing runs on machines without a GPU, so it never creates a context
+	if (argc >= 4 && std::string(argv[1]) == "precompute")
+	{
+		bool ok = precomputeOffline(argv[2], argv[3], argc >= 5 ? argv[4] : "",
+			OFFLINE_CUBEMAP_SIZE, OFFLINE_IRRADIANCE_SIZE, OFFLINE_TOLERANCE);
+		return ok ? 0 : 1;
+	}
+
 	srand(time(0));
-	GLFWwindow* window = initGL();
-	ModelRenderer mainRenderer(window, &camera);
+	GLFWwindow* window = NULL;
+#if HEADLESS
+	if (!initHeadlessGL(&window))
+		return -1;
+#else
+	window = initGL();
+	if (window == NULL)
+		return -1;
+#endif
+	ModelRenderer mainRenderer(window, &camera, HEADLESS);
+
+	// the command line may name the modes to render
+	std::vector<Render_Mode> modes;
+	for (int i = 1; i < argc; i++)
+	{
+		int m = 0;
+		while (m < RENDER_MODE_COUNT && std::string(argv[i]) != render_mode_names[m])
+			m++;
+		if (m < RENDER_MODE_COUNT)
+			modes.push_back((Render_Mode)m);
+		else
+			std::cout << "unknown render mode " << argv[i] << std::endl;
+	}
+	mainRenderer.setRenderModes(modes.empty() ? render_modes : modes);
 
 	// load parameter file
 	view_angles = loadCamParams(camera_path.c_str(), param_row);
@@ -12,10 +43,11 @@ int main(int argc, char* argv[])
 
 	// Load various shaders
 	mainRenderer.loadShaders();
+	mainRenderer.loadModel();
 
 	// main rendering loop
 	//mainRenderer.run(window);
-	mainRenderer.save(window, save_path);
+	mainRenderer.save(window, save_root);
 
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
@@ -25,13 +57,18 @@ int main(int argc, char* argv[])
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
+#if HEADLESS
+	terminateHeadlessGL();
+#else
 	glfwTerminate();
+#endif
 	return 0;
 }
 
-ModelRenderer::ModelRenderer(GLFWwindow* window, Camera* _camera)
+ModelRenderer::ModelRenderer(GLFWwindow* window, Camera* _camera, bool _headless)
 {
 	pWindow = window;
+	headless = _headless;
 	pCamera = _camera;
 	pNormalCamera = new Camera(glm::vec3(0.0f, 0.0f, 1.0f));
 
@@ -43,17 +80,43 @@ ModelRenderer::ModelRenderer(GLFWwindow* window, Camera* _camera)
 	float metal = 1.00f;
 	float rough = 0.1f;
 	pMaterial = new Material(color, rough, metal);
+	pDefaultMaterial = new Material(color, rough, metal);
 
-	pPBRShader = NULL;
+	pPBRVariants = NULL;
 	pCubemap = NULL;
 	pIrradiancemap = NULL;
 	pPrefilteredmap = NULL;
 	pBRDFmap = NULL;
+	pIBLCache = new IBLCache(ibl_cache_path, IBL_CPU_PRECOMPUTE);
+	pEnvLoader = new EnvLoader(pIBLCache, ENV_PREFETCH);
 	pBackgroundShader = NULL;
+	pFrameBlock = NULL;
+	pObjectBlock = NULL;
+
+	pWriter = new ImageWriter(ENCODER_THREADS, ENCODER_QUEUE);
+	pCapture = new FrameCapture(SAVE_WIDTH, SAVE_HEIGHT, SAVE_WIDTH, SAVE_HEIGHT, READBACK_DEPTH, pWriter);
+	pModel = NULL;
+}
 
-	pModel = new Model(model_path + model_name + ".obj");
+// load the model once the shaders exist, its vertex layout depends on the PBR shaders
+void ModelRenderer::loadModel()
+{
+	if (!usesModel())
+		return;
+	// store only the vertex attributes the PBR variants drawing the model read, in the configured formats
+	bool uv = false, normals = false, tangents = false;
+	for (unsigned int i = 0; i < passes.size(); i++)
+	{
+		if (!passes[i].model)
+			continue;
+		VertexLayout used = VertexLayout::forProgram(passes[i].pShader->ID, VERTEX_POSITION, VERTEX_TEXCOORDS, VERTEX_OCTAHEDRAL);
+		uv = uv || used.texCoords != TEXCOORD_NONE;
+		normals = normals || used.normals;
+		tangents = tangents || used.tangents;
+	}
+	VertexLayout layout(VERTEX_POSITION, uv ? VERTEX_TEXCOORDS : TEXCOORD_NONE, normals, tangents, VERTEX_OCTAHEDRAL);
+	pModel = new Model(model_path + model_name + ".obj", layout, false, OPTIMIZE_MESHES, MODEL_LODS, KEEP_MESH_DATA);
 	pModel->position = glm::mat4(1.0f);
-#if DRAW_MODE == 1 || DRAW_MODE == 4
 	std::array<float, 9> stats = readTxtFile(model_path + model_name + ".txt");
 	camera_dist = stats[0];
 	//pModel->position = glm::rotate(pModel->position, glm::radians(0.0f), glm::vec3(1.0, 0.0, 0.0));
@@ -62,7 +125,6 @@ ModelRenderer::ModelRenderer(GLFWwindow* window, Camera* _camera)
 	pModel->position = glm::rotate(pModel->position, glm::radians(stats[1]), glm::vec3(stats[2], stats[3], stats[4]));
 	pModel->position = glm::translate(pModel->position, glm::vec3(stats[5], stats[6], stats[7])); // translate it down so it's at the center of the scene
 	pModel->position = glm::scale(pModel->position, glm::vec3(stats[8]));	// it's a bit too big for our scene, so scale it down
-#endif
 }
 
 void ModelRenderer::run(GLFWwindow* _window)
@@ -73,7 +135,8 @@ void ModelRenderer::run(GLFWwindow* _window)
 	glfwGetFramebufferSize(_window, &scrWidth, &scrHeight);
 	glViewport(0, 0, scrWidth, scrHeight);
 
-	pCamera->SetPositionDist(0.0f, 0.0f, 0.0f, camera_dist);
+	const RenderPass& pass = passes[0];
+	pCamera->SetPositionDist(0.0f, 0.0f, 0.0f, passCameraDist(pass));
 
 	while (!glfwWindowShouldClose(pWindow))
 	{
@@ -92,29 +155,12 @@ void ModelRenderer::run(GLFWwindow* _window)
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		setPBRShader();
-
-		// bind pre-computed IBL data
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, pIrradiancemap->getID());
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, pPrefilteredmap->getID());
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, pBRDFmap->getID());
-
-		//pSphere->render();
-		pPBRShader->setMat4("model", pModel->position);
-#if DRAW_MODE == 1 || DRAW_MODE == 4
-		pModel->Draw(pPBRShader);
-		//pSphere->render();
-#elif DRAW_MODE == 2 || DRAW_MODE == 3
-		pSphere->render();
-#endif
+		// the window shows the first mode of the pass
+		setPBRShader(pass);
+		drawPass(pass, (float)scrHeight);
 
 		// skybox
 		pBackgroundShader->use();
-		glm::mat4 view = pCamera->GetViewMatrix();
-		pBackgroundShader->setMat4("view", view);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, pCubemap->getID());
 		pCube->render();
@@ -136,55 +182,64 @@ void ModelRenderer::save(GLFWwindow* _window, std::string _path)
 	pCubemap->loadEnvfromDirectory(env_path, env_list, env_name, env_count);
 	int per_env = (int)(param_row / env_count);
 
+	// every mode writes to a directory of its own
+	for (unsigned int m = 0; m < modes.size(); m++)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(_path + render_mode_names[modes[m]], ec);
+	}
+
 	for (int i = 0; i < env_count; i++)
 	{
 		createMaps(env_list[i].c_str());
+		// decode the next environments while this one renders
+		for (int k = 1; k <= ENV_PREFETCH && i + k < env_count; k++)
+			pEnvLoader->prefetch(env_list[i + k]);
 
-		int scrWidth, scrHeight;
-		glfwGetFramebufferSize(_window, &scrWidth, &scrHeight);
-		glViewport(0, 0, scrWidth, scrHeight);
+		int scrWidth = 0, scrHeight = 0;
+		if (!headless)
+			glfwGetFramebufferSize(_window, &scrWidth, &scrHeight);
 
 		for (int j = 0; j < per_env; j++)
 		{
 			cnt = i * per_env + j;
 			// set camera view
 			std::array<float, CAMERA_DIMS> view_angle = view_angles[cnt];
-			pCamera->SetPositionDist(view_angle[0], view_angle[1], view_angle[2], camera_dist);
-			pNormalCamera->SetPositionDist(pCamera->Yaw, pCamera->Pitch, pCamera->Bank, 1.0f);
-
-			// render
-			// ------
-			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-#if DRAW_MODE == 1 || DRAW_MODE == 2 || DRAW_MODE == 4
 			std::array<float, RENDER_DIMS> param = params[cnt];
 			pMaterial->setColor(glm::vec3(param[0], param[1], param[2]));
 			pMaterial->setMetallic(param[3]);
 			pMaterial->setRoughness(param[4]);
-#endif
-			setPBRShader();
-			// bind pre-computed IBL data
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, pIrradiancemap->getID());
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, pPrefilteredmap->getID());
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, pBRDFmap->getID());
-
-			pPBRShader->setMat4("model", pModel->position); 
-#if DRAW_MODE == 1 || DRAW_MODE == 4
-			pModel->Draw(pPBRShader);
-#elif DRAW_MODE == 2 || DRAW_MODE == 3
-			pSphere->render();
-#endif
+
 			// enumerate the screenshot filename
-			std::string path = "IMG";
-			std::string number = std::to_string(cnt++);
 			std::stringstream ss;
-			ss << std::setw(5) << std::setfill('0') << number;
-			path = _path + path + ss.str() + ".jpg";
-
-			saveScreenshot(path, 256, 256);
+			ss << "IMG" << std::setw(5) << std::setfill('0') << cnt << ".jpg";
+
+			for (unsigned int p = 0; p < passes.size(); p++)
+			{
+				const RenderPass& pass = passes[p];
+				pCamera->SetPositionDist(view_angle[0], view_angle[1], view_angle[2], passCameraDist(pass));
+
+				// render every mode of the pass into the export target at once
+				// ----------------------------------------------------------------
+				pass.pTarget->bind();
+				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				setPBRShader(pass);
+				// the export target renders at SUPERSAMPLE times the saved height
+				drawPass(pass, (float)(SAVE_HEIGHT * SUPERSAMPLE));
+
+				pass.pTarget->resolve();
+				for (unsigned int m = 0; m < pass.modes.size(); m++)
+				{
+					pass.pTarget->readOutput(m);
+					pCapture->capture(_path + render_mode_names[pass.modes[m]] + "/" + ss.str());
+				}
+			}
+
+			// nothing is presented in headless mode, so there is no swap to wait on
+			if (headless)
+				continue;
+			passes[0].pTarget->present(scrWidth, scrHeight);
 
 			// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 			// -------------------------------------------------------------------------------
@@ -192,33 +247,163 @@ void ModelRenderer::save(GLFWwindow* _window, std::string _path)
 			glfwPollEvents();
 		}
 	}
+	// write out the frames still in flight
+	pCapture->flush();
+	pWriter->drain();
+}
+
+void ModelRenderer::setRenderModes(const std::vector<Render_Mode>& modes)
+{
+	// a mode named twice is still written once
+	this->modes.clear();
+	for (unsigned int i = 0; i < modes.size(); i++)
+	{
+		if (std::find(this->modes.begin(), this->modes.end(), modes[i]) == this->modes.end())
+			this->modes.push_back(modes[i]);
+	}
+}
+
+bool ModelRenderer::usesModel() const
+{
+	for (unsigned int i = 0; i < passes.size(); i++)
+	{
+		if (passes[i].model)
+			return true;
+	}
+	return false;
 }
 
-void ModelRenderer::setPBRShader()
+void ModelRenderer::createPasses()
 {
-	pPBRShader->use();
-	pPBRShader->setInt("irradianceMap", 0);
-	pPBRShader->setInt("prefilterMap", 1);
-	pPBRShader->setInt("brdfLUT", 2);
-
-	// pass projection, view, and model matrices to shader
-	glm::mat4 projection = glm::perspective(glm::radians(pCamera->Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	pPBRShader->setMat4("projection", projection);
-	glm::mat4 view = pCamera->GetViewMatrix();
-	pPBRShader->setMat4("view", view);
+	passes.clear();
+	for (unsigned int i = 0; i < modes.size(); i++)
+	{
+		Render_Mode mode = modes[i];
+		bool model = mode == RENDER_ORIGIN || mode == RENDER_NORMAL;
+		bool normal = mode == RENDER_NORMAL;
+
+		// join a pass of the same geometry that doesn't write this kind of output yet
+		RenderPass* target = NULL;
+		for (unsigned int p = 0; p < passes.size() && !target; p++)
+		{
+			if (passes[p].model != model)
+				continue;
+			bool taken = false;
+			for (unsigned int m = 0; m < passes[p].modes.size(); m++)
+			{
+				if (passes[p].modes[m] == mode || (passes[p].modes[m] == RENDER_NORMAL) == normal)
+					taken = true;
+			}
+			if (!taken)
+				target = &passes[p];
+		}
+		if (!target)
+		{
+			RenderPass pass;
+			pass.model = model;
+			pass.pMaterial = pMaterial;
+			pass.pShader = NULL;
+			pass.pTarget = NULL;
+			passes.push_back(pass);
+			target = &passes.back();
+		}
+		target->modes.push_back(mode);
+		if (mode == RENDER_ENV)
+			target->pMaterial = pDefaultMaterial;
+	}
+
+	for (unsigned int p = 0; p < passes.size(); p++)
+		createPass(passes[p]);
+}
+
+void ModelRenderer::createPass(RenderPass& pass)
+{
+	// only the instructions the modes of the pass need are compiled in, each output
+	// going to the color attachment of its mode
+	std::vector<std::string> defines;
+	bool shaded = false;
+	for (unsigned int m = 0; m < pass.modes.size(); m++)
+	{
+		if (pass.modes[m] == RENDER_NORMAL)
+			defines.push_back("NORMAL_OUTPUT " + std::to_string(m));
+		else
+		{
+			defines.push_back("SHADED_OUTPUT " + std::to_string(m));
+			shaded = true;
+		}
+	}
+	if (shaded)
+	{
+		if (PBR_TEXTURED_ALBEDO)
+			defines.push_back("TEXTURED_ALBEDO");
+		if (PBR_TONEMAP)
+			defines.push_back("TONEMAP");
+		if (IBL_SH_IRRADIANCE)
+			defines.push_back("SH_IRRADIANCE");
+	}
+	pass.pShader = pPBRVariants->get(defines);
+
+	pass.uniforms.irradianceMap = pass.pShader->uniform("irradianceMap");
+	pass.uniforms.prefilterMap = pass.pShader->uniform("prefilterMap");
+	pass.uniforms.brdfLUT = pass.pShader->uniform("brdfLUT");
+	pass.uniforms.octNormals = pass.pShader->uniform("octNormals");
+	pass.uniforms.shCoeffs = pass.pShader->uniform("shCoeffs");
+	pass.pShader->bindBlock("Frame", FRAME_BLOCK);
+	pass.pShader->bindBlock("Object", OBJECT_BLOCK);
+	// keep the albedo texture off the IBL units even when a batch has no textures to bind
+	pass.pShader->use();
+	glUniform1i(pass.pShader->samplerLocation("texture_diffuse", 1), MATERIAL_TEXTURE_UNIT);
+
+	pass.pTarget = new RenderTarget(SAVE_WIDTH, SAVE_HEIGHT, SUPERSAMPLE, EXPORT_SAMPLES, pDownsampleShader, (int)pass.modes.size());
+}
+
+void ModelRenderer::setPBRShader(const RenderPass& pass)
+{
+	Shader* pShader = pass.pShader;
+	const PBRUniforms& pbr = pass.uniforms;
+	pShader->use();
+	pShader->setInt(pbr.irradianceMap, 0);
+	pShader->setInt(pbr.prefilterMap, 1);
+	pShader->setInt(pbr.brdfLUT, 2);
+	// only the model packs its normals octahedrally, the sphere keeps plain ones
+	pShader->setBool(pbr.octNormals, pass.model && pModel->layout.octahedral);
+#if IBL_SH_IRRADIANCE
+	pShader->setVec3Array(pbr.shCoeffs, shIrradiance, 9);
+#endif
+
+	// pass projection, view and camera position in one write of the Frame block
+	FrameBlock& frame = pFrameBlock->data;
+	frame.projection = glm::perspective(glm::radians(pCamera->Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+	frame.view = pCamera->GetViewMatrix();
 	pNormalCamera->SetPositionDist(pCamera->Yaw, pCamera->Pitch, pCamera->Bank, 1.0f);
-	glm::mat4 nor_view = pNormalCamera->GetRUDMatrix();
-	pPBRShader->setMat4("normal_view", nor_view);
-	glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-	pPBRShader->setMat4("model", model);
-
-	// camera uniform variable
-	pPBRShader->setVec3("camPos", pCamera->getPosition());
-
-	pPBRShader->setVec3("albedo", pMaterial->getColor());
-	pPBRShader->setFloat("roughness", pMaterial->getRoughness());
-	pPBRShader->setFloat("metallic", pMaterial->getMetallic());
-	pPBRShader->setFloat("ao", 1.0f);
+	frame.normalView = pNormalCamera->GetRUDMatrix();
+	frame.camPos = pCamera->getPosition();
+	pFrameBlock->update();
+
+	// and the model matrix and material in one write of the Object block
+	ObjectBlock& object = pObjectBlock->data;
+	object.model = pass.model ? pModel->position : glm::mat4(1.0f);
+	object.albedo = pass.pMaterial->getColor();
+	object.roughness = pass.pMaterial->getRoughness();
+	object.metallic = pass.pMaterial->getMetallic();
+	object.ao = 1.0f;
+	pObjectBlock->update();
+
+	// bind pre-computed IBL data
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, pIrradiancemap->getID());
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, pPrefilteredmap->getID());
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, pBRDFmap->getID());
+}
+
+void ModelRenderer::drawPass(const RenderPass& pass, float viewportHeight)
+{
+	if (pass.model)
+		pModel->Draw(pass.pShader, pModel->selectLod(pCamera->Position, pCamera->Zoom, viewportHeight, LOD_PIXEL_ERROR));
+	else
+		pSphere->render();
 }
 
 GLFWwindow* initGL()
@@ -257,47 +442,95 @@ GLFWwindow* initGL()
 
 	// configure global opengl state
 	// -----------------------------
-	glEnable(GL_DEPTH_TEST);
-	// set depth function to less than AND equal for skybox depth trick.
-	glDepthFunc(GL_LEQUAL);
-	// enable seamless cubemap sampling for lower mip levels in the pre-filter map.
-	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	configureGL();
 
 	return window;
 }
 
 void ModelRenderer::loadShaders()
 {
+	Shader::setBinaryCache(shader_cache_path);
 	// build and compile our shader zprogram
 	// ------------------------------------
-#if DRAW_MODE != 4
-	pPBRShader = new Shader("./shader_code/pbr.vert", "./shader_code/pbr.frag");
-#else
-	pPBRShader = new Shader("./shader_code/pbr.vert", "./shader_code/pbrNormal.frag");
-#endif
+	pPBRVariants = new ShaderVariants("./shader_code/pbr.vert", "./shader_code/pbr.frag");
+	setIBLFormat(IBL_FORMAT);
 	pCubemap = new Cubemap("./shader_code/cubemap.vert", "./shader_code/cubemap.frag");
 	pIrradiancemap = new Irradiancemap("./shader_code/cubemap.vert", "./shader_code/irradiance.frag", pCubemap);
 	pPrefilteredmap = new Prefilteredmap("./shader_code/cubemap.vert", "./shader_code/prefilter.frag", pCubemap);
-	pBRDFmap = new BRDFmap("./shader_code/brdf.vert", "./shader_code/brdf.frag", pCubemap);
+	pPrefilteredmap->setSampleCount(PREFILTER_SAMPLES);
+	pBRDFmap = new BRDFmap("./shader_code/brdf.vert", "./shader_code/brdf.frag");
+	// the BRDF LUT is shared by every environment, so it is only made once
+	if (!pBRDFmap->load(brdf_lut_path.c_str()))
+	{
+		pBRDFmap->create();
+		pBRDFmap->save(brdf_lut_path.c_str());
+	}
 	pBackgroundShader = new Shader("./shader_code/background.vert", "./shader_code/background.frag");
 
-	// background shader
+	// background shader, its camera comes from the Frame block
 	pBackgroundShader->use();
 	pBackgroundShader->setInt("environmentMap", 0);
-	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	pBackgroundShader->setMat4("projection", projection);
+	pBackgroundShader->bindBlock("Frame", FRAME_BLOCK);
+
+	pFrameBlock = new UniformBuffer<FrameBlock>(FRAME_BLOCK);
+	pObjectBlock = new UniformBuffer<ObjectBlock>(OBJECT_BLOCK);
+
+	pDownsampleShader = new Shader("./shader_code/brdf.vert", "./shader_code/downsample.frag");
+	pDownsampleShader->use();
+	pDownsampleShader->setInt("source", 0);
+
+	// one PBR variant and export target for each group of render modes
+	createPasses();
 }
 
 void ModelRenderer::createMaps(std::string env_path)
 {
+	// with SH irradiance the irradiance map is never allocated
+	Irradiancemap* irradiance = IBL_SH_IRRADIANCE ? NULL : pIrradiancemap;
+
+	// the image was usually decoded in the background already
+	EnvImage env = pEnvLoader->take(env_path);
+
+	// reuse the maps of an environment we have already seen
+	if (pIBLCache->load(env.hash, pCubemap, irradiance, pPrefilteredmap, shIrradiance))
+	{
+		std::cout << env_path << " loaded from IBL cache" << std::endl;
+		return;
+	}
+	// the loader skips the decode when there is a cache entry, but the entry may be stale
+	if (env.rgb.empty())
+		env = EnvLoader::read(env_path, pIBLCache, true);
+	if (env.rgb.empty())
+		return;
+	std::cout << env_path << " loaded" << std::endl;
+
+#if IBL_SH_IRRADIANCE
+	projectIrradianceSH(env.rgb.data(), env.width, env.height, shIrradiance);
+#endif
+
+#if IBL_CPU_PRECOMPUTE
+	// load environment and pre-calculate the irradiance on all cores
+	std::vector<float> faces;
+	equirectToCubemap(env.rgb.data(), env.width, env.height, pCubemap->getSize(), faces);
+	pCubemap->upload(faces.data());
+#if !IBL_SH_IRRADIANCE
+	std::vector<float> irr;
+	convolveIrradiance(faces, pCubemap->getSize(), pIrradiancemap->getSize(), irr);
+	pIrradiancemap->upload(irr.data());
+#endif
+#else
 	// load environment
-	pCubemap->loadHDR(env_path.c_str());
+	pCubemap->setHDR(env.rgb.data(), env.width, env.height);
 	pCubemap->create();
 
 	// pre-calculate illumination maps
+#if !IBL_SH_IRRADIANCE
 	pIrradiancemap->create();
+#endif
+#endif
 	pPrefilteredmap->create();
-	pBRDFmap->create();
+
+	pIBLCache->save(env.hash, pCubemap, irradiance, pPrefilteredmap, shIrradiance);
 }
 
 
@@ -361,37 +594,6 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll((float)yoffset);
 }
 
-bool saveScreenshot(std::string filename, int width, int height)
-{
-	// row alignment
-	glPixelStorei(GL_PACK_ALIGNMENT, 1);
-
-	int nScrSize = SCR_WIDTH * SCR_HEIGHT * 4;
-	int nSize = width * height * 4;
-	unsigned char* dataBuffer = (unsigned char*)malloc(nScrSize * sizeof(unsigned char));
-	unsigned char* resizedBuffer = (unsigned char*)malloc(nSize * sizeof(unsigned char));
-	if (!dataBuffer) {
-		std::cout << "saveScreenshot() :: buffer allocation error." << std::endl;
-		return false;
-	}
-
-	// fetch image from the backbuffer
-	glReadPixels((GLint)0, (GLint)0, (GLint)SCR_WIDTH, (GLint)SCR_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, dataBuffer);
-
-	stbir_resize(dataBuffer, SCR_WIDTH, SCR_HEIGHT, 0, resizedBuffer, width, height, 0,
-		STBIR_TYPE_UINT8, 4, STBIR_ALPHA_CHANNEL_NONE, 0,
-		STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
-		STBIR_COLORSPACE_SRGB, nullptr);
-	stbi_flip_vertically_on_write(true);
-	stbi_write_jpg(filename.c_str(), width, height, 4, resizedBuffer, 100);
-
-	free(dataBuffer);
-	free(resizedBuffer);
-
-	std::cout << "saving screenshot(" << filename << ")\n";
-	return true;
-}
-
 std::vector<std::array<float, CAMERA_DIMS>> loadCamParams(const char* filename, int rows)
 {
 	std::ifstream fin;
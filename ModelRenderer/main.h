@@ -1,13 +1,16 @@
 #ifndef _MAIN_H_
 #define _MAIN_H_
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <array>
 #include <string>
 #include <ctime>
+#include <filesystem>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -16,12 +19,20 @@
 #include <glm/gtc/random.hpp>
 #include <assimp/Importer.hpp>
 
+#include "context.h"
 #include "camera.h"
 #include "shader.h"
+#include "uniformbuffer.h"
 #include "environment.h"
+#include "iblcache.h"
+#include "precompute.h"
+#include "envloader.h"
 #include "polygon.h"
 #include "material.h"
 #include "model.h"
+#include "target.h"
+#include "capture.h"
+#include "writer.h"
 #include "stb_image.h"
 #include "stb_image_write.h"
 #include "stb_image_resize.h"
@@ -29,14 +40,62 @@
 #define SCR_WIDTH 640
 #define SCR_HEIGHT 640
 
+// size of the saved images
+#define SAVE_WIDTH 256
+#define SAVE_HEIGHT 256
+// the export target renders at SUPERSAMPLE times the saved size with EXPORT_SAMPLES x MSAA
+#define SUPERSAMPLE 2
+#define EXPORT_SAMPLES 4
+// number of frames in flight between rendering and writing the screenshot
+#define READBACK_DEPTH 3
+// encoder threads writing the screenshots (0 = one per core) and the number of frames they may queue
+#define ENCODER_THREADS 0
+#define ENCODER_QUEUE 8
+
+// render without a visible window and without swapping buffers (see context.h)
+#define HEADLESS 0
+// build the environment cubemap and the irradiance map on the CPU instead of with the GL passes
+#define IBL_CPU_PRECOMPUTE 0
+// "ModelRenderer precompute <hdr> <out dir> [reference dir]" runs the CPU precompute without a GL
+// context at the sizes of Cubemap and Irradiancemap, failing above this RMSE from the reference
+#define OFFLINE_CUBEMAP_SIZE 256
+#define OFFLINE_IRRADIANCE_SIZE 128
+#define OFFLINE_TOLERANCE 0.01
+// light the diffuse term from 9 spherical harmonics coefficients instead of the irradiance map
+#define IBL_SH_IRRADIANCE 0
+// variants of pbr.frag: albedo from the diffuse texture of the model instead of the material color,
+// and tonemapped, gamma corrected output (the normal render mode writes normals regardless)
+#define PBR_TEXTURED_ALBEDO false
+#define PBR_TONEMAP true
+// GGX samples per texel of the roughest prefiltered level (smoother levels take fewer)
+#define PREFILTER_SAMPLES 1024
+// internal format of the IBL textures: GL_RGB32F, GL_RGB16F, GL_R11F_G11F_B10F or GL_RGB9_E5
+#define IBL_FORMAT GL_RGB32F
+// environments decoded in the background ahead of the one being rendered
+#define ENV_PREFETCH 1
+// vertex buffer formats of the model (see vertexlayout.h); attributes the PBR shader doesn't read are dropped
+#define VERTEX_POSITION POSITION_FLOAT
+#define VERTEX_TEXCOORDS TEXCOORD_HALF
+#define VERTEX_OCTAHEDRAL true
+// deduplicate and cache-optimize the meshes at import; the result is kept in the mesh cache
+#define OPTIMIZE_MESHES true
+// levels of detail per mesh, each with a quarter of the triangles of the last (1 = full meshes only),
+// and the largest error in pixels of the level picked for the distance of the camera
+#define MODEL_LODS 4
+#define LOD_PIXEL_ERROR 0.5f
+// keep the imported vertices and indices in memory after the upload, otherwise they are freed
+#define KEEP_MESH_DATA false
+
 #define CAMERA_DIMS 3
 #define RENDER_DIMS 5
 
 // enable optimus!
+#ifdef _WIN32
 extern "C" {
 	_declspec(dllexport) DWORD NvOptimusEnablement = 1;
 	_declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1;
 }
+#endif
 
 
 double lastX = SCR_WIDTH / 2.0;
@@ -53,7 +112,6 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-bool saveScreenshot(std::string filename, int width, int height);
 std::array<float, 9> readTxtFile(std::string txtfile);
 
 std::vector<std::array<float, CAMERA_DIMS>> loadCamParams(const char* filename, int rows);
@@ -63,22 +121,29 @@ std::vector<std::array<float, RENDER_DIMS>> params;
 
 GLFWwindow*		initGL();
 
-#define DRAW_MODE 4
+// what a run renders; every mode is written to its own folder under save_root
+enum Render_Mode {
+	RENDER_ORIGIN,		// the model, shaded with the sampled material
+	RENDER_SPHERE,		// a sphere, shaded with the sampled material
+	RENDER_ENV,			// a sphere with the default material
+	RENDER_NORMAL,		// the view-space normals of the model
+	RENDER_MODE_COUNT
+};
+// folder (and command line name) of every mode
+const char* render_mode_names[RENDER_MODE_COUNT] = { "origin", "sphere", "env", "normal" };
+// the modes written by a run unless the command line names others, e.g. "ModelRenderer origin normal".
+// modes drawing the same geometry share one pass and are written through multiple render targets.
+std::vector<Render_Mode> render_modes = { RENDER_NORMAL };
+
 std::string category1 = "cars";
 //std::string category2 = "..";
 std::string model_name = "1995-jaguar-xj12-lwb-x305";
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-#if DRAW_MODE == 1
-float camera_dist = 3.0f;
-#elif DRAW_MODE == 2
-float camera_dist = 2.626f;
-#elif DRAW_MODE == 3
-float camera_dist = 2.626f;
-#elif DRAW_MODE == 4 
+// camera distance of the model modes, replaced by the one in the model's .txt, and of the sphere modes
 float camera_dist = 4.0f;
-#endif
+float sphere_dist = 2.626f;
 
 const int param_row = 1000;
 std::string param_path = "D:/Data/param/input/" + category1 + "/" + model_name + ".bin";
@@ -87,43 +152,87 @@ std::string model_path = "D:/Data/obj/" + category1 + "/";
 
 std::string env_path = "D:/Data/env/mixed/train/";
 std::string env_filename = "abandoned_tank_farm_05_2k.hdr";
+// precomputed IBL maps are cached here by HDR file hash (empty to disable)
+std::string ibl_cache_path = "D:/Data/cache/ibl/";
+// baked split-sum BRDF LUT (RG16F), written on the first run if it doesn't exist
+std::string brdf_lut_path = "D:/Data/cache/brdf_lut.rg16f";
+// linked shader programs are cached here by source and driver (empty to disable)
+std::string shader_cache_path = "D:/Data/cache/shaders/";
 
-#if DRAW_MODE == 1
-std::string save_path = "D:/Data/img/" + category1 + "/" + model_name + "/origin/";
-#elif DRAW_MODE == 2
-std::string save_path = "D:/Data/img/" + category1 + "/" + model_name + "/sphere/";
-#elif DRAW_MODE == 3
-std::string save_path = "D:/Data/img/" + category1 + "/" + model_name + "/env/";
-#elif DRAW_MODE == 4
-std::string save_path = "D:/Data/img/" + category1 + "/" + model_name + "/normal/";
-#endif
+std::string save_root = "D:/Data/img/" + category1 + "/" + model_name + "/";
 
 class ModelRenderer
 {
 public:
-	ModelRenderer(GLFWwindow* window, Camera* _camera);
+	ModelRenderer(GLFWwindow* window, Camera* _camera, bool _headless = false);
 
+	// the modes to render, set before loadShaders
+	void setRenderModes(const std::vector<Render_Mode>& modes);
 	void loadShaders();
+	void loadModel();
 	void createMaps(std::string env_path);
+	// preview the first render pass in the window
 	void run(GLFWwindow* _window);
+	// write the images of every mode into <_path><mode name>/
 	void save(GLFWwindow* _window, std::string _path);
 
-	void setPBRShader();
-
 	// camera
 	Camera* pCamera;
-	// Material
+	// Material, set from the render parameters of every sample
 	Material* pMaterial;
+	// material of the env mode
+	Material* pDefaultMaterial;
 
 private:
 	GLFWwindow* pWindow;
+	bool headless;
 	
-	Shader* pPBRShader;
+	// handles of the uniforms setPBRShader sets every frame
+	struct PBRUniforms
+	{
+		Uniform irradianceMap, prefilterMap, brdfLUT, octNormals, shCoeffs;
+	};
+	// modes drawn from one geometry submission: at most one shaded and one normal mode of the same
+	// geometry, each written to its own color attachment of the pass target
+	struct RenderPass
+	{
+		std::vector<Render_Mode> modes;		// in attachment order
+		bool model;							// the model, otherwise the sphere
+		Material* pMaterial;
+		Shader* pShader;					// the pbr variant writing the modes
+		PBRUniforms uniforms;
+		RenderTarget* pTarget;
+	};
+
+	std::vector<Render_Mode> modes;
+	std::vector<RenderPass> passes;
+	// variants of pbr.vert and pbr.frag
+	ShaderVariants* pPBRVariants;
+
+	// group the modes into passes
+	void createPasses();
+	// build the pbr variant of a pass
+	void createPass(RenderPass& pass);
+	// set the uniforms and blocks of the pass and use its shader
+	void setPBRShader(const RenderPass& pass);
+	// draw the geometry of the pass, seen on a viewport viewportHeight pixels high
+	void drawPass(const RenderPass& pass, float viewportHeight);
+	bool usesModel() const;
+	float passCameraDist(const RenderPass& pass) const { return pass.model ? camera_dist : sphere_dist; }
+	// camera and per-draw blocks shared by the PBR and background shaders
+	UniformBuffer<FrameBlock>* pFrameBlock;
+	UniformBuffer<ObjectBlock>* pObjectBlock;
 	Cubemap* pCubemap;
 	Irradiancemap* pIrradiancemap;
 	Prefilteredmap* pPrefilteredmap;
 	BRDFmap* pBRDFmap;
+	IBLCache* pIBLCache;
+	EnvLoader* pEnvLoader;
+	// irradiance of the current environment as SH coefficients (IBL_SH_IRRADIANCE)
+	glm::vec3 shIrradiance[9];
 	Shader* pBackgroundShader;
+	// downsample filter shared by the export targets of every pass
+	Shader* pDownsampleShader;
 
 	Camera* pNormalCamera;
 
@@ -133,6 +242,10 @@ private:
 
 	// Models
 	Model* pModel;
+
+	// asynchronous screenshot readback and encoding; every pass has its own export target
+	ImageWriter* pWriter;
+	FrameCapture* pCapture;
 };
 
 #endif
\ No newline at end of file
@@ -7,63 +7,97 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "vertexlayout.h"
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <utility>
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-    //bone indexes which will influence this vertex
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    //weights from each bone
-    float m_Weights[MAX_BONE_INFLUENCE];
-};
-
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// first texture unit of the material textures; the ones below hold the IBL maps of the PBR shader
+// (irradianceMap, prefilterMap, brdfLUT), and a unit can't serve a 2D and a cube sampler at once
+const unsigned int MATERIAL_TEXTURE_UNIT = 3;
+
+// bind the textures to consecutive units from MATERIAL_TEXTURE_UNIT and point the
+// texture_<type>N samplers at them
+void bindTextures(Shader* shader, const vector<Texture>& textures);
+
+// a level of detail of a mesh: a range of its indices and how far it strays from the full mesh
+struct MeshLod {
+    unsigned int firstIndex;    // from the first index of the mesh
+    unsigned int indexCount;
+    float error;                // in model units
+};
+
+// A mesh is a range of the packed vertex and index buffers of its Model (see Model::setupBuffers).
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    VertexLayout         layout;
     unsigned int VAO;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    // where the mesh starts in the model buffers
+    unsigned int baseVertex;
+    unsigned int firstIndex;
+    // indices of the levels of detail, the full mesh first; indices holds them one after the other
+    vector<MeshLod> lods;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, takes over the imported vertices until the model packs them
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, const VertexLayout& layout = VertexLayout())
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->layout = layout;
+        vertexCount = (unsigned int)this->vertices.size();
+        indexCount = (unsigned int)this->indices.size();
+        VAO = 0;
+        baseVertex = 0;
+        firstIndex = 0;
+        MeshLod full = { 0, indexCount, 0.0f };
+        lods.assign(1, full);
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // a mesh whose data is uploaded from memory owned elsewhere (a mapped mesh cache);
+    // the vertices and indices vectors stay empty
+    Mesh(unsigned int vertexCount, unsigned int indexCount, vector<Texture> textures, const VertexLayout& layout)
+    {
+        this->textures = std::move(textures);
+        this->layout = layout;
+        this->vertexCount = vertexCount;
+        this->indexCount = indexCount;
+        VAO = 0;
+        baseVertex = 0;
+        firstIndex = 0;
+        MeshLod full = { 0, indexCount, 0.0f };
+        lods.assign(1, full);
     }
 
-    // render the mesh
-    void Draw(Shader* shader);
-    
-private:
-    // render data 
-    unsigned int VBO, EBO;
+    // a mesh holds the whole imported geometry, so it is moved and never copied
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&&) noexcept = default;
+    Mesh& operator=(Mesh&&) noexcept = default;
+
+    // free the vertices and indices once they are in the model buffers; the counts stay
+    void releaseData()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh();
+    // render a level of detail of the mesh on its own
+    void Draw(Shader* shader, unsigned int lod = 0);
 };
-#endif
\ No newline at end of file
+#endif
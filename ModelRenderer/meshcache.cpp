@@ -0,0 +1,216 @@
+#include "meshcache.h"
+
+static const char CACHE_MAGIC[4] = { 'M', 'C', 'H', 'E' };
+static const unsigned int CACHE_VERSION = 4;
+
+struct CacheHeader
+{
+    char magic[4];
+    unsigned int version;
+    unsigned int layoutKey;             // VertexLayout::key() of the vertex blobs
+    unsigned int meshCount;
+    unsigned int textureCount;
+    unsigned int optimized;             // the meshes went through the meshopt passes
+    unsigned int lodCount;              // levels of detail of every mesh
+    float bounds[4];                    // bounding sphere of the model
+    unsigned long long sourceSize;      // size and modification time of the model file
+    long long sourceTime;
+};
+
+// size and modification time of the model file, to tell a stale cache apart
+static bool sourceStamp(const std::string& modelPath, unsigned long long& size, long long& time)
+{
+    std::error_code ec;
+    size = std::filesystem::file_size(modelPath, ec);
+    if (ec)
+        return false;
+    auto modified = std::filesystem::last_write_time(modelPath, ec);
+    if (ec)
+        return false;
+    time = (long long)modified.time_since_epoch().count();
+    return true;
+}
+
+MeshCache::MeshCache()
+{
+    meshRecords = nullptr;
+    textureRecords = nullptr;
+    lodRecords = nullptr;
+    meshCount = 0;
+    textureCount = 0;
+    lodCount = 0;
+    bounds = glm::vec4(0.0f);
+    stride = 0;
+}
+
+std::string MeshCache::cachePath(const std::string& modelPath)
+{
+    return modelPath + ".mcache";
+}
+
+bool MeshCache::open(const std::string& modelPath, const VertexLayout& layout, bool optimized, unsigned int lods)
+{
+    close();
+    unsigned long long size;
+    long long time;
+    if (!sourceStamp(modelPath, size, time) || !file.open(cachePath(modelPath).c_str()))
+        return false;
+
+    const unsigned char* data = file.getData();
+    size_t fileSize = file.getSize();
+    const CacheHeader* header = (const CacheHeader*)data;
+    if (fileSize < sizeof(CacheHeader) || memcmp(header->magic, CACHE_MAGIC, 4) != 0 || header->version != CACHE_VERSION
+        || header->layoutKey != layout.key() || header->sourceSize != size || header->sourceTime != time || (optimized && !header->optimized)
+        || header->lodCount != lods)
+    {
+        close();
+        return false;
+    }
+
+    size_t tables = sizeof(CacheHeader) + header->meshCount * sizeof(MeshRecord) + header->textureCount * sizeof(TextureRecord)
+        + (size_t)header->meshCount * header->lodCount * sizeof(MeshLod);
+    if (fileSize < tables)
+    {
+        close();
+        return false;
+    }
+    meshRecords = (const MeshRecord*)(data + sizeof(CacheHeader));
+    textureRecords = (const TextureRecord*)(data + sizeof(CacheHeader) + header->meshCount * sizeof(MeshRecord));
+    lodRecords = (const MeshLod*)(textureRecords + header->textureCount);
+    meshCount = header->meshCount;
+    textureCount = header->textureCount;
+    lodCount = header->lodCount;
+    bounds = glm::vec4(header->bounds[0], header->bounds[1], header->bounds[2], header->bounds[3]);
+    stride = layout.getStride();
+
+    // every blob and texture reference must lie inside the file
+    for (unsigned int i = 0; i < meshCount; i++)
+    {
+        const MeshRecord& mesh = meshRecords[i];
+        if (mesh.vertexOffset + (unsigned long long)mesh.vertexCount * stride > fileSize
+            || mesh.indexOffset + (unsigned long long)mesh.indexCount * sizeof(unsigned int) > fileSize
+            || mesh.textureFirst + mesh.textureCount > header->textureCount)
+        {
+            close();
+            return false;
+        }
+        for (unsigned int l = 0; l < lodCount; l++)
+        {
+            const MeshLod& lod = getLod(i, l);
+            if ((unsigned long long)lod.firstIndex + lod.indexCount > mesh.indexCount)
+            {
+                close();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void MeshCache::close()
+{
+    file.close();
+    meshRecords = nullptr;
+    textureRecords = nullptr;
+    lodRecords = nullptr;
+    meshCount = 0;
+    textureCount = 0;
+    lodCount = 0;
+}
+
+const void* MeshCache::getVertices(unsigned int i) const
+{
+    return file.getData() + meshRecords[i].vertexOffset;
+}
+
+const unsigned int* MeshCache::getIndices(unsigned int i) const
+{
+    return (const unsigned int*)(file.getData() + meshRecords[i].indexOffset);
+}
+
+bool MeshCache::save(const std::string& modelPath, const std::vector<Mesh>& meshes, const glm::vec4& bounds, bool optimized)
+{
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    if (!sourceStamp(modelPath, header.sourceSize, header.sourceTime))
+        return false;
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.optimized = optimized ? 1 : 0;
+    header.meshCount = (unsigned int)meshes.size();
+    header.lodCount = meshes.empty() ? 1 : (unsigned int)meshes[0].lods.size();
+    for (int c = 0; c < 4; c++)
+        header.bounds[c] = bounds[c];
+    // every mesh of a model shares the layout
+    VertexLayout layout = meshes.empty() ? VertexLayout() : meshes[0].layout;
+    header.layoutKey = layout.key();
+
+    std::vector<MeshRecord> meshTable(meshes.size());
+    std::vector<TextureRecord> textureTable;
+    std::vector<MeshLod> lodTable;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        lodTable.insert(lodTable.end(), meshes[i].lods.begin(), meshes[i].lods.end());
+        meshTable[i].textureFirst = (unsigned int)textureTable.size();
+        meshTable[i].textureCount = (unsigned int)meshes[i].textures.size();
+        for (size_t t = 0; t < meshes[i].textures.size(); t++)
+        {
+            TextureRecord texture;
+            memset(&texture, 0, sizeof(texture));
+            strncpy(texture.type, meshes[i].textures[t].type.c_str(), sizeof(texture.type) - 1);
+            strncpy(texture.path, meshes[i].textures[t].path.c_str(), sizeof(texture.path) - 1);
+            textureTable.push_back(texture);
+        }
+    }
+    header.textureCount = (unsigned int)textureTable.size();
+
+    // blobs follow the tables, vertices then indices of each mesh, 16 byte aligned
+    unsigned long long offset = sizeof(CacheHeader) + meshTable.size() * sizeof(MeshRecord) + textureTable.size() * sizeof(TextureRecord)
+        + lodTable.size() * sizeof(MeshLod);
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        offset = (offset + 15) & ~15ull;
+        meshTable[i].vertexCount = (unsigned int)meshes[i].vertices.size();
+        meshTable[i].vertexOffset = offset;
+        offset += meshes[i].vertices.size() * layout.getStride();
+        offset = (offset + 15) & ~15ull;
+        meshTable[i].indexCount = (unsigned int)meshes[i].indices.size();
+        meshTable[i].indexOffset = offset;
+        offset += meshes[i].indices.size() * sizeof(unsigned int);
+    }
+
+    // write to a temporary file and rename it, so a concurrent run never maps a partial cache
+    std::string path = cachePath(modelPath);
+    std::string temp = tempPath(path);
+    std::ofstream fout(temp, std::ios::out | std::ios::binary);
+    fout.write((const char*)&header, sizeof(header));
+    fout.write((const char*)meshTable.data(), meshTable.size() * sizeof(MeshRecord));
+    fout.write((const char*)textureTable.data(), textureTable.size() * sizeof(TextureRecord));
+    fout.write((const char*)lodTable.data(), lodTable.size() * sizeof(MeshLod));
+    const char padding[16] = { 0 };
+    std::vector<unsigned char> packed;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        packed.resize(meshes[i].vertices.size() * layout.getStride());
+        layout.pack(meshes[i].vertices.data(), meshes[i].vertices.size(), packed.data());
+        fout.write(padding, meshTable[i].vertexOffset - (unsigned long long)fout.tellp());
+        fout.write((const char*)packed.data(), packed.size());
+        fout.write(padding, meshTable[i].indexOffset - (unsigned long long)fout.tellp());
+        fout.write((const char*)meshes[i].indices.data(), meshes[i].indices.size() * sizeof(unsigned int));
+    }
+    fout.close();
+    std::error_code ec;
+    if (!fout)
+    {
+        std::cout << "Failed to write mesh cache " << path << std::endl;
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    std::filesystem::rename(temp, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
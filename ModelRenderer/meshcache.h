@@ -0,0 +1,79 @@
+#ifndef _MESHCACHE_H_
+#define _MESHCACHE_H_
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include "mesh.h"
+#include "mappedfile.h"
+#include "tempfile.h"
+
+// Binary cache of an imported model, written next to it as <model>.mcache. It holds a header,
+// a mesh table, the texture references and index ranges of the levels of detail of every mesh,
+// and the raw vertex and index blobs in the
+// vertex layout Mesh uploads, so a later run maps the file and hands the blobs straight to OpenGL
+// instead of running the Assimp import. An entry is only used while the model file has the size
+// and modification time recorded in it and it was packed in the requested vertex layout with the
+// requested number of levels of detail.
+class MeshCache
+{
+public:
+    struct MeshRecord
+    {
+        unsigned int vertexCount;
+        unsigned int indexCount;
+        unsigned long long vertexOffset;    // bytes from the start of the file
+        unsigned long long indexOffset;
+        unsigned int textureFirst;
+        unsigned int textureCount;
+    };
+
+    struct TextureRecord
+    {
+        char type[32];
+        char path[260];
+    };
+
+private:
+    MappedFile file;
+    const MeshRecord* meshRecords;
+    const TextureRecord* textureRecords;
+    const MeshLod* lodRecords;
+    unsigned int meshCount;
+    unsigned int textureCount;
+    unsigned int lodCount;
+    glm::vec4 bounds;
+    unsigned int stride;
+
+public:
+    MeshCache();
+
+    static std::string cachePath(const std::string& modelPath);
+
+    // map the cache of the model; false if there is none, it doesn't match the model, layout and
+    // number of levels of detail, or optimized meshes are asked for and the cache holds unoptimized ones
+    bool open(const std::string& modelPath, const VertexLayout& layout, bool optimized = false, unsigned int lods = 1);
+    void close();
+
+    unsigned int getMeshCount() const { return meshCount; }
+    const MeshRecord& getMesh(unsigned int i) const { return meshRecords[i]; }
+    unsigned int getTextureCount() const { return textureCount; }
+    const TextureRecord& getTexture(unsigned int i) const { return textureRecords[i]; }
+    unsigned int getLodCount() const { return lodCount; }
+    const MeshLod& getLod(unsigned int mesh, unsigned int lod) const { return lodRecords[mesh * lodCount + lod]; }
+    // bounding sphere of the model, center and radius
+    glm::vec4 getBounds() const { return bounds; }
+    // vertices packed in the layout given to open()
+    const void* getVertices(unsigned int i) const;
+    const unsigned int* getIndices(unsigned int i) const;
+
+    // write the cache of the model from the imported meshes, packed in their layout; every mesh
+    // has the same number of levels of detail
+    static bool save(const std::string& modelPath, const std::vector<Mesh>& meshes, const glm::vec4& bounds, bool optimized = false);
+};
+
+#endif
@@ -0,0 +1,450 @@
+#include "meshopt.h"
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    stats.triangles = (unsigned int)(indices.size() / 3);
+    stats.vertices = 0;
+    stats.transforms = 0;
+
+    // FIFO cache: a vertex is cached if it was transformed less than cacheSize misses ago
+    std::vector<unsigned int> cachedAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    unsigned int time = cacheSize + 1;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (!used[v])
+        {
+            used[v] = true;
+            stats.vertices++;
+        }
+        if (time - cachedAt[v] > cacheSize)
+        {
+            cachedAt[v] = time++;
+            stats.transforms++;
+        }
+    }
+    return stats;
+}
+
+namespace
+{
+    struct VertexHash
+    {
+        const Vertex* vertices;
+        size_t operator()(unsigned int i) const
+        {
+            // FNV-1a over the bytes of the vertex
+            const unsigned char* p = (const unsigned char*)&vertices[i];
+            size_t hash = 14695981039346656037ull;
+            for (size_t b = 0; b < sizeof(Vertex); b++)
+            {
+                hash ^= p[b];
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    struct VertexEqual
+    {
+        const Vertex* vertices;
+        bool operator()(unsigned int a, unsigned int b) const
+        {
+            return memcmp(&vertices[a], &vertices[b], sizeof(Vertex)) == 0;
+        }
+    };
+}
+
+unsigned int deduplicateVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    std::unordered_map<unsigned int, unsigned int, VertexHash, VertexEqual> unique(vertices.size(),
+        VertexHash{ vertices.data() }, VertexEqual{ vertices.data() });
+    std::vector<unsigned int> remap(vertices.size());
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        auto found = unique.find(i);
+        if (found == unique.end())
+        {
+            // the first copy of a vertex keeps its data; later ones point at it
+            unique.insert(std::make_pair(i, count));
+            remap[i] = count++;
+        }
+        else
+            remap[i] = found->second;
+    }
+
+    // gather the unique vertices into a new buffer (duplicates write identical data to their slot),
+    // then swap it in and point the indices at it
+    std::vector<Vertex> compact(count);
+    for (unsigned int i = 0; i < vertices.size(); i++)
+        compact[remap[i]] = vertices[i];
+    vertices.swap(compact);
+    for (size_t i = 0; i < indices.size(); i++)
+        indices[i] = remap[indices[i]];
+    return count;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+    unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+    if (triangleCount == 0)
+        return;
+
+    // triangles around every vertex
+    std::vector<unsigned int> live(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); i++)
+        live[indices[i]]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        for (int c = 0; c < 3; c++)
+            adjacency[fill[indices[t * 3 + c]]++] = t;
+    }
+
+    std::vector<unsigned int> cachedAt(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fan = 0;
+
+    while (fan >= 0)
+    {
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (unsigned int a = offsets[fan]; a < offsets[fan + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int v = indices[t * 3 + c];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cachedAt[v] > cacheSize)
+                    cachedAt[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // next fanning vertex: the candidate that stays in the cache longest and still has triangles
+        int best = -1;
+        int bestPriority = -1;
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            unsigned int v = candidates[i];
+            if (live[v] == 0)
+                continue;
+            int priority = 0;
+            if (time - cachedAt[v] + 2 * live[v] <= cacheSize)
+                priority = time - cachedAt[v];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        if (best < 0)
+        {
+            // dead end: go back through recently emitted vertices, then scan in input order
+            while (!deadEnd.empty())
+            {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0)
+                {
+                    best = v;
+                    break;
+                }
+            }
+            while (best < 0 && cursor < vertexCount)
+            {
+                if (live[cursor] > 0)
+                    best = cursor;
+                cursor++;
+            }
+        }
+        fan = best;
+    }
+    indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (remap[v] == unused)
+        {
+            remap[v] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[v]);
+        }
+        indices[i] = remap[v];
+    }
+    vertices.swap(ordered);
+}
+
+namespace
+{
+    // sum of squared distances to a set of planes, weighted by the triangle areas:
+    // the symmetric 4x4 matrix of Garland and Heckbert, upper triangle
+    struct Quadric
+    {
+        double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+        double weight;
+    };
+
+    void addPlane(Quadric& q, const glm::dvec3& n, double d, double weight)
+    {
+        q.xx += weight * n.x * n.x; q.xy += weight * n.x * n.y; q.xz += weight * n.x * n.z; q.xw += weight * n.x * d;
+        q.yy += weight * n.y * n.y; q.yz += weight * n.y * n.z; q.yw += weight * n.y * d;
+        q.zz += weight * n.z * n.z; q.zw += weight * n.z * d;
+        q.ww += weight * d * d;
+        q.weight += weight;
+    }
+
+    void addQuadric(Quadric& q, const Quadric& r)
+    {
+        q.xx += r.xx; q.xy += r.xy; q.xz += r.xz; q.xw += r.xw;
+        q.yy += r.yy; q.yz += r.yz; q.yw += r.yw;
+        q.zz += r.zz; q.zw += r.zw;
+        q.ww += r.ww;
+        q.weight += r.weight;
+    }
+
+    // mean squared distance of p to the planes of q and r together
+    double quadricError(const Quadric& q, const Quadric& r, const glm::vec3& p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double error = (q.xx + r.xx) * x * x + 2.0 * (q.xy + r.xy) * x * y + 2.0 * (q.xz + r.xz) * x * z + 2.0 * (q.xw + r.xw) * x
+                     + (q.yy + r.yy) * y * y + 2.0 * (q.yz + r.yz) * y * z + 2.0 * (q.yw + r.yw) * y
+                     + (q.zz + r.zz) * z * z + 2.0 * (q.zw + r.zw) * z
+                     + (q.ww + r.ww);
+        double weight = q.weight + r.weight;
+        return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+    }
+
+    struct PositionHash
+    {
+        const Vertex* vertices;
+        size_t operator()(unsigned int i) const
+        {
+            const unsigned char* p = (const unsigned char*)&vertices[i].Position;
+            size_t hash = 14695981039346656037ull;
+            for (size_t b = 0; b < sizeof(glm::vec3); b++)
+            {
+                hash ^= p[b];
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    struct PositionEqual
+    {
+        const Vertex* vertices;
+        bool operator()(unsigned int a, unsigned int b) const
+        {
+            return vertices[a].Position == vertices[b].Position;
+        }
+    };
+
+    struct Collapse
+    {
+        unsigned int from;
+        unsigned int to;
+        double error;
+
+        bool operator<(const Collapse& other) const { return error < other.error; }
+    };
+}
+
+std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float targetError, float* resultError)
+{
+    std::vector<unsigned int> result(indices);
+    unsigned int vertexCount = (unsigned int)vertices.size();
+    double errorLimit = (double)targetError * targetError;
+    double maxError = 0.0;
+
+    // vertices sharing a position are one point of the surface; it gets the quadric of all their triangles
+    std::unordered_map<unsigned int, unsigned int, PositionHash, PositionEqual> points(vertices.size(),
+        PositionHash{ vertices.data() }, PositionEqual{ vertices.data() });
+    std::vector<unsigned int> point(vertexCount);
+    std::vector<unsigned int> wedges(vertexCount, 0);
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        point[i] = points.insert(std::make_pair(i, i)).first->second;
+        wedges[point[i]]++;
+    }
+
+    // a point is locked if its vertices differ in their attributes (a seam) or it lies on an open
+    // or non-manifold edge: an edge whose reverse direction isn't used exactly once
+    std::vector<bool> locked(vertexCount, false);
+    for (unsigned int i = 0; i < vertexCount; i++)
+        locked[i] = wedges[point[i]] > 1;
+    std::unordered_map<unsigned long long, unsigned int> edges(result.size());
+    for (size_t t = 0; t + 2 < result.size(); t += 3)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            unsigned long long a = point[result[t + c]], b = point[result[t + (c + 1) % 3]];
+            edges[(a << 32) | b]++;
+        }
+    }
+    for (auto it = edges.begin(); it != edges.end(); ++it)
+    {
+        unsigned long long a = it->first >> 32, b = it->first & 0xffffffffull;
+        auto reverse = edges.find((b << 32) | a);
+        if (it->second != 1 || reverse == edges.end() || reverse->second != 1)
+        {
+            locked[(unsigned int)a] = true;
+            locked[(unsigned int)b] = true;
+        }
+    }
+    for (unsigned int i = 0; i < vertexCount; i++)
+        locked[i] = locked[point[i]];
+
+    std::vector<Quadric> quadrics(vertexCount);
+    memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+    for (size_t t = 0; t + 2 < result.size(); t += 3)
+    {
+        glm::dvec3 p0 = vertices[result[t]].Position, p1 = vertices[result[t + 1]].Position, p2 = vertices[result[t + 2]].Position;
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double area = glm::length(n);
+        if (area == 0.0)
+            continue;
+        n /= area;
+        for (int c = 0; c < 3; c++)
+            addPlane(quadrics[point[result[t + c]]], n, -glm::dot(n, p0), area * 0.5);
+    }
+
+    // passes of independent collapses, cheapest first, until the target is met or nothing collapses
+    std::vector<unsigned int> offsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<Collapse> collapses;
+    while (result.size() > targetIndexCount)
+    {
+        // triangles around every vertex
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (size_t i = 0; i < result.size(); i++)
+            offsets[result[i] + 1]++;
+        for (unsigned int v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+
+        // the cheapest edge of every free vertex, collapsing it onto the other end
+        collapses.clear();
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            if (locked[v] || offsets[v] == offsets[v + 1])
+                continue;
+            Collapse best = { v, v, 0.0 };
+            for (unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+            {
+                const unsigned int* tri = &result[adjacency[a] * 3];
+                for (int c = 0; c < 3; c++)
+                {
+                    unsigned int to = tri[c];
+                    if (to == v)
+                        continue;
+                    double error = quadricError(quadrics[v], quadrics[point[to]], vertices[to].Position);
+                    if (best.to == v || error < best.error)
+                    {
+                        best.to = to;
+                        best.error = error;
+                    }
+                }
+            }
+            if (best.to != v && best.error <= errorLimit)
+                collapses.push_back(best);
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        for (unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+        size_t remaining = result.size();
+        unsigned int done = 0;
+        for (size_t i = 0; i < collapses.size() && remaining > targetIndexCount; i++)
+        {
+            const Collapse& collapse = collapses[i];
+            unsigned int from = collapse.from, to = collapse.to;
+            if (touched[from] || touched[to])
+                continue;
+
+            // the triangles that stay must not flip or turn by more than about 75 degrees
+            bool flips = false;
+            unsigned int removed = 0;
+            for (unsigned int a = offsets[from]; a < offsets[from + 1] && !flips; a++)
+            {
+                const unsigned int* tri = &result[adjacency[a] * 3];
+                if (tri[0] == to || tri[1] == to || tri[2] == to)
+                {
+                    removed++;
+                    continue;
+                }
+                int c = tri[0] == from ? 0 : tri[1] == from ? 1 : 2;
+                glm::vec3 p1 = vertices[tri[(c + 1) % 3]].Position, p2 = vertices[tri[(c + 2) % 3]].Position;
+                glm::vec3 before = glm::cross(p1 - vertices[from].Position, p2 - vertices[from].Position);
+                glm::vec3 after = glm::cross(p1 - vertices[to].Position, p2 - vertices[to].Position);
+                flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+            }
+            if (flips)
+                continue;
+
+            // the neighbourhood of the collapse is left alone for the rest of the pass
+            for (unsigned int a = offsets[from]; a < offsets[from + 1]; a++)
+            {
+                const unsigned int* tri = &result[adjacency[a] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+            }
+            remap[from] = to;
+            addQuadric(quadrics[point[to]], quadrics[from]);
+            maxError = std::max(maxError, collapse.error);
+            remaining -= removed * 3;
+            done++;
+        }
+        if (done == 0)
+            break;
+
+        // drop the triangles that lost an edge
+        size_t write = 0;
+        for (size_t t = 0; t + 2 < result.size(); t += 3)
+        {
+            unsigned int a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (resultError)
+        *resultError = (float)std::sqrt(maxError);
+    return result;
+}
@@ -0,0 +1,48 @@
+#ifndef _MESHOPT_H_
+#define _MESHOPT_H_
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include "vertexlayout.h"
+
+// Load-time optimization of indexed triangle lists, run on every mesh after the import:
+//   1. deduplicateVertices merges bitwise identical vertices (OBJ imports repeat every corner)
+//   2. optimizeVertexCache reorders the triangles for the post-transform cache (Tipsify,
+//      Sander et al. 2007)
+//   3. optimizeVertexFetch renumbers the vertices in the order the triangles first use them
+// and analyzeVertexCache measures the result on a FIFO cache. simplifyMesh builds the coarser
+// levels of detail of a mesh.
+
+struct VertexCacheStats
+{
+    unsigned int triangles;
+    unsigned int vertices;
+    unsigned int transforms;    // cache misses
+
+    // average cache miss ratio: transforms per triangle (0.5 at best, 3 at worst)
+    float acmr() const { return triangles ? (float)transforms / triangles : 0.0f; }
+    // average transform to vertex ratio (1 at best)
+    float atvr() const { return vertices ? (float)transforms / vertices : 0.0f; }
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize = 16);
+
+// returns the number of vertices left
+unsigned int deduplicateVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize = 16);
+// also drops vertices no triangle uses
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// Quadric error metric simplification (Garland and Heckbert 1997) down to targetIndexCount indices
+// or until a collapse would move the surface further than targetError, in model units. A vertex only
+// ever collapses onto a neighbour, so the result indexes the same vertices and every level of detail
+// shares the vertex buffer of the full mesh. Vertices on open edges and attribute seams stay put.
+// The largest error of the collapses done is returned in resultError.
+std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+#endif
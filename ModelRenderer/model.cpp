@@ -1,13 +1,169 @@
 #include "model.h"
 
-void Model::Draw(Shader* shader)
+Model::~Model()
 {
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+void Model::Draw(Shader* shader, unsigned int lod)
+{
+    lod = std::min(lod, (unsigned int)lodErrors.size() - 1);
+
+    // one multi-draw per set of textures
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    for (unsigned int i = 0; i < batches.size(); i++)
+    {
+        bindTextures(shader, batches[i].textures);
+        unsigned int first = lod * commandsPerLod + batches[i].firstCommand;
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(first * sizeof(DrawCommand)), batches[i].commandCount, 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+unsigned int Model::selectLod(const glm::vec3& eye, float fovy, float viewportHeight, float pixelError) const
+{
+    // the model matrix may scale the model, take its largest axis
+    float scale = std::max(glm::length(glm::vec3(position[0])), std::max(glm::length(glm::vec3(position[1])), glm::length(glm::vec3(position[2]))));
+    glm::vec3 center = glm::vec3(position * glm::vec4(glm::vec3(bounds), 1.0f));
+    // pixels per unit at the nearest point of the bounding sphere
+    float distance = std::max(glm::length(eye - center) - bounds.w * scale, 1e-4f);
+    float pixels = viewportHeight * 0.5f / (distance * tan(glm::radians(fovy) * 0.5f));
+
+    unsigned int lod = 0;
+    while (lod + 1 < lodErrors.size() && lodErrors[lod + 1] * scale * pixels <= pixelError)
+        lod++;
+    return lod;
+}
+
+void Model::setupBuffers(const MeshCache* cache)
+{
+    if (meshes.empty())
+        return;
+
+    // place the meshes one after the other
+    size_t vertexTotal = 0, indexTotal = 0;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        meshes[i].baseVertex = (unsigned int)vertexTotal;
+        meshes[i].firstIndex = (unsigned int)indexTotal;
+        vertexTotal += meshes[i].vertexCount;
+        indexTotal += meshes[i].indexCount;
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &commandBuffer);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexTotal * layout.getStride(), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexTotal * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+
+    vector<unsigned char> packed;
     for (unsigned int i = 0; i < meshes.size(); i++)
-        meshes[i].Draw(shader);
+    {
+        Mesh& mesh = meshes[i];
+        const void* vertexData;
+        const unsigned int* indexData;
+        if (cache)
+        {
+            vertexData = cache->getVertices(i);
+            indexData = cache->getIndices(i);
+        }
+        else
+        {
+            packed.resize((size_t)mesh.vertexCount * layout.getStride());
+            layout.pack(mesh.vertices.data(), mesh.vertexCount, packed.data());
+            vertexData = packed.data();
+            indexData = mesh.indices.data();
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, (size_t)mesh.baseVertex * layout.getStride(), (size_t)mesh.vertexCount * layout.getStride(), vertexData);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (size_t)mesh.firstIndex * sizeof(unsigned int), (size_t)mesh.indexCount * sizeof(unsigned int), indexData);
+        mesh.VAO = VAO;
+    }
+    layout.setupAttributes();
+    glBindVertexArray(0);
+
+    // group the meshes by their textures, keeping the first-seen order of the groups
+    map<vector<pair<string, unsigned int>>, unsigned int> batchOf;
+    vector<vector<unsigned int>> members;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        vector<pair<string, unsigned int>> key;
+        for (unsigned int t = 0; t < meshes[i].textures.size(); t++)
+            key.push_back(make_pair(meshes[i].textures[t].type, meshes[i].textures[t].id));
+        auto found = batchOf.find(key);
+        if (found == batchOf.end())
+        {
+            found = batchOf.insert(make_pair(key, (unsigned int)batches.size())).first;
+            DrawBatch batch;
+            batch.textures = meshes[i].textures;
+            batch.firstCommand = 0;
+            batch.commandCount = 0;
+            batches.push_back(batch);
+            members.push_back(vector<unsigned int>());
+        }
+        members[found->second].push_back(i);
+    }
+
+    vector<DrawCommand> commands;
+    for (unsigned int b = 0; b < batches.size(); b++)
+    {
+        batches[b].firstCommand = (unsigned int)commands.size();
+        batches[b].commandCount = (unsigned int)members[b].size();
+        commands.resize(commands.size() + members[b].size());
+    }
+    commandsPerLod = (unsigned int)commands.size();
+    commands.resize((size_t)commandsPerLod * lodCount);
+    lodErrors.assign(lodCount, 0.0f);
+    for (unsigned int l = 0; l < lodCount; l++)
+    {
+        for (unsigned int b = 0; b < batches.size(); b++)
+        {
+            for (unsigned int m = 0; m < members[b].size(); m++)
+            {
+                const Mesh& mesh = meshes[members[b][m]];
+                const MeshLod& lod = mesh.lods[l];
+                DrawCommand command = { lod.indexCount, 1, mesh.firstIndex + lod.firstIndex, mesh.baseVertex, 0 };
+                commands[l * commandsPerLod + batches[b].firstCommand + m] = command;
+                lodErrors[l] = std::max(lodErrors[l], lod.error);
+            }
+        }
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    cout << meshes.size() << " meshes in " << batches.size() << " draw batches" << endl;
+    if (lodCount > 1)
+    {
+        cout << "levels of detail:";
+        for (unsigned int l = 0; l < lodCount; l++)
+        {
+            size_t triangles = 0;
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                triangles += meshes[i].lods[l].indexCount / 3;
+            cout << " " << triangles << " (" << lodErrors[l] << ")";
+        }
+        cout << endl;
+    }
 }
 
 void Model::loadModel(string const& path)
 {
+    // retrieve the directory path of the filepath
+    directory = path.substr(0, path.find_last_of('/'));
+    if (loadCache(path))
+        return;
+
     // read file via ASSIMP
     Assimp::Importer importer;
     const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -17,182 +173,298 @@ void Model::loadModel(string const& path)
         cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
         return;
     }
-    // retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
 
     // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+    vector<const aiMesh*> imported;
+    processNode(scene->mRootNode, scene, imported);
+
+    // textures are GL objects, so they are uploaded here on the context thread once they are decoded
+    preloadTextures(scene, imported);
+    map<unsigned int, vector<Texture>> materials;
+    meshes.reserve(imported.size());
+    for (unsigned int i = 0; i < imported.size(); i++)
+        meshes.push_back(Mesh(vector<Vertex>(), vector<unsigned int>(), materialTextures(scene, imported[i]->mMaterialIndex, materials), layout));
+    // then the meshes are converted in parallel
+    parallelFor((int)imported.size(), [&](int i) {
+        processMesh(imported[i], meshes[i]);
+    });
+    if (optimize)
+        optimizeMeshes();
+    if (lodCount > 1)
+        buildLods();
+    computeBounds();
+    setupBuffers();
+
+    MeshCache::save(path, meshes, bounds, optimize);
+    if (!keepData)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].releaseData();
+    }
+}
+
+bool Model::loadCache(string const& path)
+{
+    MeshCache cache;
+    if (!cache.open(path, layout, optimize, lodCount))
+        return false;
+    bounds = cache.getBounds();
+
+    vector<string> files;
+    for (unsigned int t = 0; t < cache.getTextureCount(); t++)
+        files.push_back(directory + '/' + cache.getTexture(t).path);
+    TextureCache::shared().load(files);
+
+    for (unsigned int i = 0; i < cache.getMeshCount(); i++)
+    {
+        const MeshCache::MeshRecord& record = cache.getMesh(i);
+        vector<Texture> textures;
+        for (unsigned int t = 0; t < record.textureCount; t++)
+        {
+            const MeshCache::TextureRecord& texture = cache.getTexture(record.textureFirst + t);
+            textures.push_back(loadTexture(texture.path, texture.type));
+        }
+        meshes.push_back(Mesh(record.vertexCount, record.indexCount, textures, layout));
+        meshes.back().lods.assign(&cache.getLod(i, 0), &cache.getLod(i, 0) + lodCount);
+    }
+    // the buffers are uploaded straight from the mapped file
+    setupBuffers(&cache);
+    cout << path << " loaded from mesh cache" << endl;
+    return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+void Model::processNode(aiNode* node, const aiScene* scene, vector<const aiMesh*>& imported)
 {
-    // process each mesh located at the current node
+    // collect each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
         // the node object only contains indices to index the actual objects in the scene. 
         // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        imported.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
     // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, imported);
     }
 
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+const vector<Texture>& Model::materialTextures(const aiScene* scene, unsigned int material, map<unsigned int, vector<Texture>>& loaded)
 {
-    // data to fill
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
+    auto found = loaded.find(material);
+    if (found != loaded.end())
+        return found->second;
+
+    aiMaterial* mat = scene->mMaterials[material];
     vector<Texture> textures;
+    // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
+    // Same applies to other texture as the following list summarizes:
+    // diffuse: texture_diffuseN
+    // specular: texture_specularN
+    // normal: texture_normalN
+
+    // 1. diffuse maps
+    vector<Texture> diffuseMaps = loadMaterialTextures(mat, aiTextureType_DIFFUSE, "texture_diffuse");
+    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    // 2. specular maps
+    vector<Texture> specularMaps = loadMaterialTextures(mat, aiTextureType_SPECULAR, "texture_specular");
+    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    // 3. normal maps
+    std::vector<Texture> normalMaps = loadMaterialTextures(mat, aiTextureType_HEIGHT, "texture_normal");
+    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+    // 4. height maps
+    std::vector<Texture> heightMaps = loadMaterialTextures(mat, aiTextureType_AMBIENT, "texture_height");
+    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+
+    return loaded.insert(make_pair(material, textures)).first->second;
+}
+
+void Model::processMesh(const aiMesh* mesh, Mesh& target)
+{
+    // data to fill, sized up front
+    vector<Vertex>& vertices = target.vertices;
+    vector<unsigned int>& indices = target.indices;
+    vertices.resize(mesh->mNumVertices);
 
     // walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
-        Vertex vertex;
-        glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+        Vertex& vertex = vertices[i];
+        // assimp uses its own vector class that doesn't directly convert to glm's vec3 class, so the data is copied by component.
         // positions
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.Position = vector;
+        vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
         // normals
         if (mesh->HasNormals())
-        {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
-        }
+            vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
         // texture coordinates
         if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
         {
-            glm::vec2 vec;
             // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
             // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.TexCoords = vec;
+            vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
             // tangent
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
+            vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
             // bitangent
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
+            vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
         }
         else
             vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-        vertices.push_back(vertex);
     }
-    // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+    // now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+    size_t indexCount = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        indexCount += mesh->mFaces[i].mNumIndices;
+    indices.resize(indexCount);
+    unsigned int* index = indices.data();
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
         // retrieve all indices of the face and store them in the indices vector
         for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+            *index++ = face.mIndices[j];
     }
-    // process materials
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-    // Same applies to other texture as the following list summarizes:
-    // diffuse: texture_diffuseN
-    // specular: texture_specularN
-    // normal: texture_normalN
 
-    // 1. diffuse maps
-    vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-    // 2. specular maps
-    vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-    // 3. normal maps
-    std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-    // 4. height maps
-    std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-    // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    target.vertexCount = (unsigned int)vertices.size();
+    target.indexCount = (unsigned int)indices.size();
+    target.lods[0].indexCount = target.indexCount;
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+void Model::optimizeMeshes()
 {
-    vector<Texture> textures;
-    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+    // the meshes are optimized in parallel, their statistics are summed up after
+    vector<VertexCacheStats> beforeStats(meshes.size()), afterStats(meshes.size());
+    vector<size_t> importedCounts(meshes.size());
+    parallelFor((int)meshes.size(), [&](int i) {
+        Mesh& mesh = meshes[i];
+        beforeStats[i] = analyzeVertexCache(mesh.indices, (unsigned int)mesh.vertices.size());
+        importedCounts[i] = mesh.vertices.size();
+
+        deduplicateVertices(mesh.vertices, mesh.indices);
+        optimizeVertexCache(mesh.indices, (unsigned int)mesh.vertices.size());
+        optimizeVertexFetch(mesh.vertices, mesh.indices);
+        mesh.vertexCount = (unsigned int)mesh.vertices.size();
+        mesh.indexCount = (unsigned int)mesh.indices.size();
+
+        afterStats[i] = analyzeVertexCache(mesh.indices, mesh.vertexCount);
+    });
+
+    VertexCacheStats before = { 0, 0, 0 }, after = { 0, 0, 0 };
+    size_t importedVertices = 0, vertices = 0;
+    for (unsigned int i = 0; i < meshes.size(); i++)
     {
-        aiString str;
-        mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        before.triangles += beforeStats[i].triangles;
+        before.vertices += beforeStats[i].vertices;
+        before.transforms += beforeStats[i].transforms;
+        after.triangles += afterStats[i].triangles;
+        after.vertices += afterStats[i].vertices;
+        after.transforms += afterStats[i].transforms;
+        importedVertices += importedCounts[i];
+        vertices += meshes[i].vertices.size();
+    }
+    cout << "mesh optimization: vertices " << importedVertices << " -> " << vertices
+         << ", ACMR " << before.acmr() << " -> " << after.acmr()
+         << ", ATVR " << before.atvr() << " -> " << after.atvr() << endl;
+}
+
+void Model::buildLods()
+{
+    // every mesh is simplified on its own
+    parallelFor((int)meshes.size(), [&](int i) {
+        Mesh& mesh = meshes[i];
+        // the simplifier needs the vertices welded; this is a no-op on optimized meshes
+        if (!optimize)
         {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+            deduplicateVertices(mesh.vertices, mesh.indices);
+            mesh.vertexCount = (unsigned int)mesh.vertices.size();
+        }
+
+        // every level starts from the one before it, so the errors add up
+        vector<unsigned int> level(mesh.indices);
+        for (unsigned int l = 1; l < lodCount; l++)
+        {
+            MeshLod lod = mesh.lods.back();
+            float error = 0.0f;
+            vector<unsigned int> simplified = simplifyMesh(mesh.vertices, level, level.size() / 12 * 3, FLT_MAX, &error);
+            // a mesh that can't be simplified any further repeats its last level
+            if (!simplified.empty() && simplified.size() < level.size())
             {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
+                optimizeVertexCache(simplified, mesh.vertexCount);
+                lod.firstIndex = (unsigned int)mesh.indices.size();
+                lod.indexCount = (unsigned int)simplified.size();
+                lod.error += error;
+                mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+                level.swap(simplified);
             }
+            mesh.lods.push_back(lod);
         }
-        if (!skip)
-        {   // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        mesh.indexCount = (unsigned int)mesh.indices.size();
+    });
+}
+
+void Model::computeBounds()
+{
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        for (unsigned int v = 0; v < meshes[i].vertices.size(); v++)
+        {
+            lo = glm::min(lo, meshes[i].vertices[v].Position);
+            hi = glm::max(hi, meshes[i].vertices[v].Position);
         }
     }
-    return textures;
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = 0.0f;
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        for (unsigned int v = 0; v < meshes[i].vertices.size(); v++)
+            radius = std::max(radius, glm::length(meshes[i].vertices[v].Position - center));
+    }
+    bounds = glm::vec4(center, radius);
 }
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+void Model::preloadTextures(const aiScene* scene, const vector<const aiMesh*>& imported)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    static const aiTextureType types[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_AMBIENT };
+    vector<bool> used(scene->mNumMaterials, false);
+    vector<string> files;
+    for (unsigned int i = 0; i < imported.size(); i++)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        unsigned int material = imported[i]->mMaterialIndex;
+        if (used[material])
+            continue;
+        used[material] = true;
+        for (unsigned int t = 0; t < 4; t++)
+        {
+            for (unsigned int j = 0; j < scene->mMaterials[material]->GetTextureCount(types[t]); j++)
+            {
+                aiString str;
+                scene->mMaterials[material]->GetTexture(types[t], j, &str);
+                files.push_back(directory + '/' + str.C_Str());
+            }
+        }
     }
-    else
+    TextureCache::shared().load(files);
+}
+
+vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+{
+    vector<Texture> textures;
+    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        aiString str;
+        mat->GetTexture(type, i, &str);
+        textures.push_back(loadTexture(str.C_Str(), typeName));
     }
+    return textures;
+}
 
-    return textureID;
+Texture Model::loadTexture(const string& path, const string& typeName)
+{
+    Texture texture;
+    texture.id = TextureCache::shared().get(directory + '/' + path);
+    texture.type = typeName;
+    texture.path = path;
+    return texture;
 }
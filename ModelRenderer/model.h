@@ -12,48 +12,120 @@
 
 #include "shader.h"
 #include "mesh.h"
+#include "meshcache.h"
+#include "meshopt.h"
+#include "parallel.h"
+#include "texturecache.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <algorithm>
+#include <cfloat>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
-
 class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
     glm::mat4 position;
+    // GPU layout of the vertices of every mesh
+    VertexLayout layout;
+    // run the meshopt passes on imported meshes
+    bool optimize;
+    // levels of detail of every mesh, the full mesh included
+    unsigned int lodCount;
+    // bounding sphere in model space, center and radius
+    glm::vec4 bounds;
+    // how far each level of detail strays from the full model at most, in model units
+    vector<float> lodErrors;
+
+    // keep the imported vertices and indices of the meshes after they are uploaded and cached
+    bool keepData;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const& path, const VertexLayout& layout = VertexLayout(), bool gamma = false, bool optimize = false, unsigned int lods = 1, bool keepData = false)
+        : gammaCorrection(gamma), layout(layout), optimize(optimize), lodCount(std::max(lods, 1u)), bounds(0.0f), keepData(keepData)
     {
+        VAO = VBO = EBO = commandBuffer = 0;
+        commandsPerLod = 0;
         loadModel(path);
     }
+    // the model owns its buffers; its textures belong to the shared TextureCache
+    ~Model();
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // draws a level of detail of the model, and thus all its meshes. The shader's octNormals must
+    // already match layout.octahedral (see ModelRenderer::setPBRShader).
+    void Draw(Shader* shader, unsigned int lod = 0);
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader* shader);
+    // the coarsest level of detail whose error stays under pixelError pixels, seen from eye with a
+    // vertical field of view of fovy degrees on a viewport viewportHeight pixels high
+    unsigned int selectLod(const glm::vec3& eye, float fovy, float viewportHeight, float pixelError) const;
     
 private:
+    // draw arguments of one mesh, as glMultiDrawElementsIndirect reads them
+    struct DrawCommand
+    {
+        unsigned int count;
+        unsigned int instanceCount;
+        unsigned int firstIndex;
+        unsigned int baseVertex;
+        unsigned int baseInstance;
+    };
+
+    // the draw commands of the meshes sharing a set of textures
+    struct DrawBatch
+    {
+        vector<Texture> textures;
+        unsigned int firstCommand;
+        unsigned int commandCount;
+    };
+
+    // every mesh lives in one vertex and one index buffer
+    unsigned int VAO, VBO, EBO;
+    // draw commands, grouped by batch, one set after the other for every level of detail
+    unsigned int commandBuffer;
+    unsigned int commandsPerLod;
+    vector<DrawBatch> batches;
+
+    // pack every mesh into the shared buffers and build the batched draw commands.
+    // meshes from the cache are copied from the mapped file, the others are packed from their vertices.
+    void setupBuffers(const MeshCache* cache = nullptr);
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // the imported meshes are kept in a binary cache next to the model, which later runs load instead.
     void loadModel(string const& path);
+    bool loadCache(string const& path);
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene);
+    // processes a node in a recursive fashion. Collects each individual mesh located at the node and repeats this process on its children nodes (if any).
+    void processNode(aiNode* node, const aiScene* scene, vector<const aiMesh*>& imported);
+    // the textures of a material, loaded on the context thread the first time a mesh uses it
+    const vector<Texture>& materialTextures(const aiScene* scene, unsigned int material, map<unsigned int, vector<Texture>>& loaded);
     
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    // converts the vertices and indices of an imported mesh into target; touches no GL state, so the
+    // meshes of a model are converted on worker threads
+    static void processMesh(const aiMesh* mesh, Mesh& target);
+    // deduplicate and reorder the imported meshes, and report the vertex cache efficiency
+    void optimizeMeshes();
+    // simplify every imported mesh into lodCount levels, each with a quarter of the triangles of the last
+    void buildLods();
+    void computeBounds();
     
+    // decode the texture files of the materials the meshes use on worker threads, ahead of materialTextures
+    void preloadTextures(const aiScene* scene, const vector<const aiMesh*>& imported);
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
     // the required info is returned as a Texture struct.
     vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName);
+    // a texture of the model directory from the texture cache
+    Texture loadTexture(const string& path, const string& typeName);
 };
 
 #endif
\ No newline at end of file
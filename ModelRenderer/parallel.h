@@ -0,0 +1,35 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+// run func(i) for every i in [0, count) on all hardware threads.
+// work items are handed out one at a time, so uneven items still balance across threads.
+template <typename Func>
+void parallelFor(int count, Func func, unsigned int threads = 0)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    if ((int)threads > count)
+        threads = count > 0 ? count : 1;
+
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++)
+            func(i);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < threads; t++)
+        pool.push_back(std::thread(worker));
+    // the calling thread works too
+    worker();
+    for (unsigned int t = 0; t < pool.size(); t++)
+        pool[t].join();
+}
+
+#endif
@@ -0,0 +1,383 @@
+#include "precompute.h"
+
+// AVX2 is only enabled when the compiler targets it (/arch:AVX2, -mavx2 -mfma);
+// SSE2 is part of every x64 target.
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define PRECOMPUTE_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PRECOMPUTE_SSE
+#endif
+#if defined(PRECOMPUTE_AVX2) || defined(PRECOMPUTE_SSE)
+#include <immintrin.h>
+#endif
+
+static const float PI = 3.14159265359f;
+
+static inline int clampi(int v, int lo, int hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+bool loadEquirect(const char* fname, std::vector<float>& rgb, int& width, int& height)
+{
+    if (loadHDRFile(fname, rgb, width, height))
+        return true;
+
+    // layouts the fast reader doesn't handle
+    int nrComponents;
+    float* data = loadImagef(fname, &width, &height, &nrComponents, 3, true);
+    if (!data)
+    {
+        std::cout << "Failed to load HDR image." << std::endl;
+        return false;
+    }
+    rgb.assign(data, data + (size_t)width * height * 3);
+    stbi_image_free(data);
+    return true;
+}
+
+glm::vec3 cubemapDirection(int face, int x, int y, int size)
+{
+    // inverse of the face selection table of the OpenGL spec; the result is not normalized
+    float u = 2.0f * (x + 0.5f) / size - 1.0f;
+    float v = 2.0f * (y + 0.5f) / size - 1.0f;
+    switch (face)
+    {
+    case 0: return glm::vec3( 1.0f,   -v,   -u);
+    case 1: return glm::vec3(-1.0f,   -v,    u);
+    case 2: return glm::vec3(    u, 1.0f,    v);
+    case 3: return glm::vec3(    u,-1.0f,   -v);
+    case 4: return glm::vec3(    u,   -v, 1.0f);
+    default: return glm::vec3(  -u,   -v,-1.0f);
+    }
+}
+
+// bilinear lookup with GL_CLAMP_TO_EDGE on a RGBA padded image, written as RGB
+static inline void sampleBilinear(const float* rgba, int width, int height, float u, float v, float* out)
+{
+    float x = u * width - 0.5f;
+    float y = v * height - 0.5f;
+    float x0f = std::floor(x);
+    float y0f = std::floor(y);
+    float fx = x - x0f;
+    float fy = y - y0f;
+    int x0 = clampi((int)x0f, 0, width - 1);
+    int x1 = clampi((int)x0f + 1, 0, width - 1);
+    int y0 = clampi((int)y0f, 0, height - 1);
+    int y1 = clampi((int)y0f + 1, 0, height - 1);
+    const float* p00 = rgba + ((size_t)y0 * width + x0) * 4;
+    const float* p10 = rgba + ((size_t)y0 * width + x1) * 4;
+    const float* p01 = rgba + ((size_t)y1 * width + x0) * 4;
+    const float* p11 = rgba + ((size_t)y1 * width + x1) * 4;
+
+#if defined(PRECOMPUTE_SSE)
+    // one texel per register, all channels blended at once
+    __m128 wx = _mm_set1_ps(fx);
+    __m128 wy = _mm_set1_ps(fy);
+    __m128 a = _mm_loadu_ps(p00);
+    __m128 c = _mm_loadu_ps(p01);
+    __m128 bottom = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p10), a), wx));
+    __m128 top = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p11), c), wx));
+    float result[4];
+    _mm_storeu_ps(result, _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(top, bottom), wy)));
+    out[0] = result[0];
+    out[1] = result[1];
+    out[2] = result[2];
+#else
+    for (int i = 0; i < 3; i++)
+    {
+        float bottom = p00[i] + (p10[i] - p00[i]) * fx;
+        float top = p01[i] + (p11[i] - p01[i]) * fx;
+        out[i] = bottom + (top - bottom) * fy;
+    }
+#endif
+}
+
+void equirectToCubemap(const float* rgb, int width, int height, int size, std::vector<float>& faces)
+{
+    // pad to 4 channels so every texel is a single vector load
+    std::vector<float> rgba((size_t)width * height * 4, 0.0f);
+    for (size_t i = 0; i < (size_t)width * height; i++)
+    {
+        rgba[i * 4 + 0] = rgb[i * 3 + 0];
+        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+    }
+
+    faces.resize((size_t)6 * size * size * 3);
+    parallelFor(6 * size, [&](int row) {
+        int face = row / size;
+        int y = row % size;
+        float* out = faces.data() + ((size_t)face * size * size + (size_t)y * size) * 3;
+        for (int x = 0; x < size; x++)
+        {
+            // same mapping as SampleSphericalMap() in cubemap.frag
+            glm::vec3 v = glm::normalize(cubemapDirection(face, x, y, size));
+            float s = std::atan2(v.z, v.x) * 0.1591f + 0.5f;
+            float t = std::asin(v.y) * 0.3183f + 0.5f;
+            sampleBilinear(rgba.data(), width, height, s, t, out + x * 3);
+        }
+    });
+}
+
+// sum of max(dot(n, d), 0) * radiance over all source texels
+static glm::vec3 integrateCosine(const glm::vec3& n, const float* dx, const float* dy, const float* dz,
+    const float* r, const float* g, const float* b, int count)
+{
+#if defined(PRECOMPUTE_AVX2)
+    __m256 nx = _mm256_set1_ps(n.x);
+    __m256 ny = _mm256_set1_ps(n.y);
+    __m256 nz = _mm256_set1_ps(n.z);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 ar = zero, ag = zero, ab = zero;
+    for (int i = 0; i < count; i += 8)
+    {
+        __m256 d = _mm256_fmadd_ps(nx, _mm256_loadu_ps(dx + i),
+                   _mm256_fmadd_ps(ny, _mm256_loadu_ps(dy + i),
+                   _mm256_mul_ps(nz, _mm256_loadu_ps(dz + i))));
+        d = _mm256_max_ps(d, zero);
+        ar = _mm256_fmadd_ps(d, _mm256_loadu_ps(r + i), ar);
+        ag = _mm256_fmadd_ps(d, _mm256_loadu_ps(g + i), ag);
+        ab = _mm256_fmadd_ps(d, _mm256_loadu_ps(b + i), ab);
+    }
+    float sr[8], sg[8], sb[8];
+    _mm256_storeu_ps(sr, ar);
+    _mm256_storeu_ps(sg, ag);
+    _mm256_storeu_ps(sb, ab);
+    glm::vec3 sum(0.0f);
+    for (int i = 0; i < 8; i++)
+        sum += glm::vec3(sr[i], sg[i], sb[i]);
+    return sum;
+#elif defined(PRECOMPUTE_SSE)
+    __m128 nx = _mm_set1_ps(n.x);
+    __m128 ny = _mm_set1_ps(n.y);
+    __m128 nz = _mm_set1_ps(n.z);
+    __m128 zero = _mm_setzero_ps();
+    __m128 ar = zero, ag = zero, ab = zero;
+    for (int i = 0; i < count; i += 4)
+    {
+        __m128 d = _mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(dx + i)),
+                   _mm_add_ps(_mm_mul_ps(ny, _mm_loadu_ps(dy + i)),
+                   _mm_mul_ps(nz, _mm_loadu_ps(dz + i))));
+        d = _mm_max_ps(d, zero);
+        ar = _mm_add_ps(ar, _mm_mul_ps(d, _mm_loadu_ps(r + i)));
+        ag = _mm_add_ps(ag, _mm_mul_ps(d, _mm_loadu_ps(g + i)));
+        ab = _mm_add_ps(ab, _mm_mul_ps(d, _mm_loadu_ps(b + i)));
+    }
+    float sr[4], sg[4], sb[4];
+    _mm_storeu_ps(sr, ar);
+    _mm_storeu_ps(sg, ag);
+    _mm_storeu_ps(sb, ab);
+    glm::vec3 sum(0.0f);
+    for (int i = 0; i < 4; i++)
+        sum += glm::vec3(sr[i], sg[i], sb[i]);
+    return sum;
+#else
+    glm::vec3 sum(0.0f);
+    for (int i = 0; i < count; i++)
+    {
+        float d = n.x * dx[i] + n.y * dy[i] + n.z * dz[i];
+        if (d > 0.0f)
+            sum += d * glm::vec3(r[i], g[i], b[i]);
+    }
+    return sum;
+#endif
+}
+
+void convolveIrradiance(const std::vector<float>& env, int envSize, int size, std::vector<float>& faces, int sourceSize)
+{
+    if (sourceSize <= 0 || sourceSize > envSize || envSize % sourceSize != 0)
+        sourceSize = envSize;
+    int factor = envSize / sourceSize;
+
+    // source texels as structure of arrays: unit direction and radiance times solid angle.
+    // padded with zero radiance up to a multiple of the widest vector width.
+    int count = 6 * sourceSize * sourceSize;
+    int padded = (count + 7) & ~7;
+    std::vector<float> dx(padded, 0.0f), dy(padded, 0.0f), dz(padded, 0.0f);
+    std::vector<float> r(padded, 0.0f), g(padded, 0.0f), b(padded, 0.0f);
+    float texelArea = (2.0f / sourceSize) * (2.0f / sourceSize);
+    for (int face = 0; face < 6; face++)
+    {
+        for (int y = 0; y < sourceSize; y++)
+        {
+            for (int x = 0; x < sourceSize; x++)
+            {
+                glm::vec3 radiance(0.0f);
+                for (int j = 0; j < factor; j++)
+                {
+                    for (int i = 0; i < factor; i++)
+                    {
+                        const float* p = env.data() + ((size_t)face * envSize * envSize + (size_t)(y * factor + j) * envSize + (x * factor + i)) * 3;
+                        radiance += glm::vec3(p[0], p[1], p[2]);
+                    }
+                }
+                radiance /= (float)(factor * factor);
+
+                glm::vec3 dir = cubemapDirection(face, x, y, sourceSize);
+                float len2 = glm::dot(dir, dir);
+                float solidAngle = texelArea / (len2 * std::sqrt(len2));
+                // irradiance.frag returns the integral divided by PI
+                radiance *= solidAngle / PI;
+
+                int k = (face * sourceSize + y) * sourceSize + x;
+                dir /= std::sqrt(len2);
+                dx[k] = dir.x; dy[k] = dir.y; dz[k] = dir.z;
+                r[k] = radiance.r; g[k] = radiance.g; b[k] = radiance.b;
+            }
+        }
+    }
+
+    faces.resize((size_t)6 * size * size * 3);
+    parallelFor(6 * size, [&](int row) {
+        int face = row / size;
+        int y = row % size;
+        float* out = faces.data() + ((size_t)face * size * size + (size_t)y * size) * 3;
+        for (int x = 0; x < size; x++)
+        {
+            glm::vec3 n = glm::normalize(cubemapDirection(face, x, y, size));
+            glm::vec3 irradiance = integrateCosine(n, dx.data(), dy.data(), dz.data(), r.data(), g.data(), b.data(), padded);
+            out[x * 3 + 0] = irradiance.r;
+            out[x * 3 + 1] = irradiance.g;
+            out[x * 3 + 2] = irradiance.b;
+        }
+    });
+}
+
+// L2 SH basis: Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21, Y22
+static void shBasis(const glm::vec3& d, float basis[9])
+{
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * d.y;
+    basis[2] = 0.488603f * d.z;
+    basis[3] = 0.488603f * d.x;
+    basis[4] = 1.092548f * d.x * d.y;
+    basis[5] = 1.092548f * d.y * d.z;
+    basis[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+    basis[7] = 1.092548f * d.x * d.z;
+    basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+void projectIrradianceSH(const float* rgb, int width, int height, glm::vec3 coeffs[9])
+{
+    const float PI = 3.14159265359f;
+    // every row sums into its own slot so the result doesn't depend on the thread count
+    std::vector<glm::vec3> rows((size_t)height * 9, glm::vec3(0.0f));
+    parallelFor(height, [&](int j) {
+        // inverse of the equirectangular lookup of cubemap.frag
+        float lat = ((j + 0.5f) / height - 0.5f) * PI;
+        float y = std::sin(lat);
+        float c = std::cos(lat);
+        float dOmega = (2.0f * PI / width) * (PI / height) * c;
+        glm::vec3* sum = &rows[(size_t)j * 9];
+        float basis[9];
+        for (int i = 0; i < width; i++)
+        {
+            float phi = ((i + 0.5f) / width - 0.5f) * 2.0f * PI;
+            shBasis(glm::vec3(c * std::cos(phi), y, c * std::sin(phi)), basis);
+            const float* texel = rgb + ((size_t)j * width + i) * 3;
+            glm::vec3 L(texel[0] * dOmega, texel[1] * dOmega, texel[2] * dOmega);
+            for (int k = 0; k < 9; k++)
+                sum[k] += L * basis[k];
+        }
+    });
+
+    // convolve with the clamped cosine lobe (pi, 2pi/3, pi/4) and divide by pi, so the
+    // coefficients evaluate to the same values irradiance.frag stores
+    const float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+    for (int k = 0; k < 9; k++)
+    {
+        glm::vec3 total(0.0f);
+        for (int j = 0; j < height; j++)
+            total += rows[(size_t)j * 9 + k];
+        coeffs[k] = total * band[k];
+    }
+}
+
+glm::vec3 evaluateIrradianceSH(const glm::vec3 coeffs[9], const glm::vec3& normal)
+{
+    float basis[9];
+    shBasis(glm::normalize(normal), basis);
+    glm::vec3 result(0.0f);
+    for (int k = 0; k < 9; k++)
+        result += coeffs[k] * basis[k];
+    return glm::max(result, glm::vec3(0.0f));
+}
+
+bool writeCubemapFile(const std::string& fname, const std::vector<float>& faces, int size)
+{
+    std::ofstream fout(fname, std::ios::out | std::ios::binary);
+    fout.write((const char*)&size, sizeof(size));
+    fout.write((const char*)faces.data(), faces.size() * sizeof(float));
+    return (bool)fout;
+}
+
+bool readCubemapFile(const std::string& fname, std::vector<float>& faces, int& size)
+{
+    std::ifstream fin(fname, std::ios::in | std::ios::binary);
+    if (!fin.read((char*)&size, sizeof(size)) || size <= 0)
+        return false;
+    faces.resize((size_t)6 * size * size * 3);
+    fin.read((char*)faces.data(), faces.size() * sizeof(float));
+    return (bool)fin;
+}
+
+double cubemapRMSE(const std::vector<float>& a, const std::vector<float>& b)
+{
+    if (a.size() != b.size() || a.empty())
+        return -1.0;
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        double d = (double)a[i] - (double)b[i];
+        sum += d * d;
+    }
+    return std::sqrt(sum / a.size());
+}
+
+// compare a map with its golden reference, if there is one
+static bool checkReference(const std::string& refPath, const std::vector<float>& faces, int size, double tolerance)
+{
+    std::vector<float> ref;
+    int refSize = 0;
+    if (!readCubemapFile(refPath, ref, refSize))
+    {
+        std::cout << "No reference " << refPath << std::endl;
+        return false;
+    }
+    double rmse = refSize == size ? cubemapRMSE(faces, ref) : -1.0;
+    std::cout << refPath << " RMSE " << rmse << std::endl;
+    return rmse >= 0.0 && rmse <= tolerance;
+}
+
+bool precomputeOffline(const std::string& hdrPath, const std::string& outDir, const std::string& refDir,
+    int cubemapSize, int irradianceSize, double tolerance)
+{
+    std::vector<float> rgb;
+    int width, height;
+    if (!loadEquirect(hdrPath.c_str(), rgb, width, height))
+        return false;
+
+    std::vector<float> faces, irr;
+    equirectToCubemap(rgb.data(), width, height, cubemapSize, faces);
+    convolveIrradiance(faces, cubemapSize, irradianceSize, irr);
+
+    std::string name = std::filesystem::path(hdrPath).stem().string();
+    std::error_code ec;
+    std::filesystem::create_directories(outDir, ec);
+    std::filesystem::path out(outDir);
+    if (!writeCubemapFile((out / (name + ".cubemap")).string(), faces, cubemapSize) ||
+        !writeCubemapFile((out / (name + ".irradiance")).string(), irr, irradianceSize))
+    {
+        std::cout << "Failed to write the maps of " << hdrPath << std::endl;
+        return false;
+    }
+    if (refDir.empty())
+        return true;
+
+    std::filesystem::path ref(refDir);
+    bool cubemapOk = checkReference((ref / (name + ".cubemap")).string(), faces, cubemapSize, tolerance);
+    bool irradianceOk = checkReference((ref / (name + ".irradiance")).string(), irr, irradianceSize, tolerance);
+    return cubemapOk && irradianceOk;
+}
@@ -0,0 +1,58 @@
+#ifndef _PRECOMPUTE_H_
+#define _PRECOMPUTE_H_
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <filesystem>
+
+#include "parallel.h"
+#include "hdrloader.h"
+#include "imageload.h"
+
+// CPU equivalents of the Cubemap::create and Irradiancemap::create passes, for preprocessing
+// environments on machines without a GPU and validating the GPU passes against a reference.
+//
+// Cubemaps are stored the way the GL textures are: 6 faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i
+// order, each size * size texels starting from t = 0, 3 floats per texel.
+// Equirectangular images are RGB floats flipped on load, as Cubemap::setHDR uploads them.
+
+// load a HDR equirectangular image as RGB floats
+bool loadEquirect(const char* fname, std::vector<float>& rgb, int& width, int& height);
+
+// world space direction of the center of texel (x, y) on a cubemap face
+glm::vec3 cubemapDirection(int face, int x, int y, int size);
+
+// equivalent of cubemap.frag: bilinear lookup of the equirectangular image for every texel
+void equirectToCubemap(const float* rgb, int width, int height, int size, std::vector<float>& faces);
+
+// equivalent of irradiance.frag: cosine weighted integral of the environment over the hemisphere
+// around each texel direction. The environment is box filtered down to sourceSize first, since
+// irradiance is far smoother than any texel of that size.
+void convolveIrradiance(const std::vector<float>& env, int envSize, int size, std::vector<float>& faces, int sourceSize = 32);
+
+// equivalent of irradiance.frag as 9 L2 spherical harmonics coefficients (RGB), projected straight
+// from the equirectangular image in one pass. The cosine convolution is folded into the
+// coefficients, so evaluating them at a normal gives the irradiance map value for that normal.
+void projectIrradianceSH(const float* rgb, int width, int height, glm::vec3 coeffs[9]);
+// CPU evaluation of the coefficients, as pbr.frag does it
+glm::vec3 evaluateIrradianceSH(const glm::vec3 coeffs[9], const glm::vec3& normal);
+
+// raw golden reference files: int size followed by the 6 faces
+bool writeCubemapFile(const std::string& fname, const std::vector<float>& faces, int size);
+bool readCubemapFile(const std::string& fname, std::vector<float>& faces, int& size);
+// root mean square difference of two cubemaps of the same size
+double cubemapRMSE(const std::vector<float>& a, const std::vector<float>& b);
+
+// offline preprocessing without a GL context: build the environment cubemap and irradiance map of
+// a HDR file and write them to <outDir>/<name>.cubemap and .irradiance. When refDir is not empty the
+// results are compared with the files of the same name there. Returns false if the image can't be
+// read, a file can't be written or a map differs from its reference by more than tolerance RMSE.
+bool precomputeOffline(const std::string& hdrPath, const std::string& outDir, const std::string& refDir,
+    int cubemapSize, int irradianceSize, double tolerance);
+
+#endif
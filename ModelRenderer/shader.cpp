@@ -1,13 +1,15 @@
 #include "shader.h"
 
+std::string Shader::binaryCache;
+
 Shader::Shader()
 {
 
 }
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const std::vector<std::string>& defines)
 {
-    load(vertexPath, fragmentPath, geometryPath);
+    load(vertexPath, fragmentPath, geometryPath, defines);
 }
 
 // activate the shader
@@ -19,7 +21,7 @@ void Shader::use()
 
 // load shader
 // ------------------------------------------------------------------------
-void Shader::load(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
+void Shader::load(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const std::vector<std::string>& defines)
 {
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
@@ -61,6 +63,20 @@ void Shader::load(const char* vertexPath, const char* fragmentPath, const char*
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
     }
+    injectDefines(vertexCode, defines);
+    injectDefines(fragmentCode, defines);
+    injectDefines(geometryCode, defines);
+    // a cached binary of the same sources on the same driver skips the compile
+    unsigned long long key = 0;
+    if (!binaryCache.empty())
+    {
+        key = binaryKey(vertexCode, fragmentCode, geometryCode);
+        if (loadBinary(key))
+        {
+            reflectUniforms();
+            return;
+        }
+    }
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
     // 2. compile shaders
@@ -91,71 +107,278 @@ void Shader::load(const char* vertexPath, const char* fragmentPath, const char*
     glAttachShader(ID, fragment);
     if (geometryPath != nullptr)
         glAttachShader(ID, geometry);
+    if (!binaryCache.empty())
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    if (!binaryCache.empty())
+        saveBinary(key);
     // delete the shaders as they're linked into our program now and no longer necessery
     glDeleteShader(vertex);
     glDeleteShader(fragment);
     if (geometryPath != nullptr)
         glDeleteShader(geometry);
+    reflectUniforms();
+}
+
+void Shader::injectDefines(std::string &code, const std::vector<std::string> &defines)
+{
+    if (defines.empty() || code.empty())
+        return;
+    std::string block;
+    for (size_t i = 0; i < defines.size(); i++)
+        block += "#define " + defines[i] + "\n";
+    // #version has to stay the first statement
+    size_t version = code.find("#version");
+    size_t at = version == std::string::npos ? 0 : code.find('\n', version);
+    if (at == std::string::npos)
+    {
+        code += '\n';
+        at = code.size();
+    }
+    else if (version != std::string::npos)
+        at++;
+    code.insert(at, block);
+}
+
+void Shader::setBinaryCache(const std::string &directory)
+{
+    binaryCache = directory;
+    if (!binaryCache.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(binaryCache, ec);
+    }
+}
+
+unsigned long long Shader::binaryKey(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode)
+{
+    const char* vendor = (const char*)glGetString(GL_VENDOR);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+    // every part ends with a 0, so moving text from one part to the next changes the hash
+    std::string parts[6] = { vertexCode, fragmentCode, geometryCode,
+        vendor ? vendor : "", renderer ? renderer : "", version ? version : "" };
+    unsigned long long hash = 14695981039346656037ull;
+    for (int p = 0; p < 6; p++)
+    {
+        for (size_t i = 0; i <= parts[p].size(); i++)
+        {
+            hash ^= (unsigned char)parts[p].c_str()[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+std::string Shader::binaryPath(unsigned long long key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.glbin", key);
+    return (std::filesystem::path(binaryCache) / name).string();
+}
+
+bool Shader::loadBinary(unsigned long long key)
+{
+    if (!GLEW_ARB_get_program_binary)
+        return false;
+    std::ifstream fin(binaryPath(key), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!fin)
+        return false;
+    std::streamoff size = fin.tellg();
+    if (size <= (std::streamoff)sizeof(GLenum))
+        return false;
+    fin.seekg(0);
+    GLenum format = 0;
+    fin.read((char*)&format, sizeof(format));
+    std::vector<char> binary((size_t)size - sizeof(format));
+    fin.read(binary.data(), binary.size());
+    if (!fin || fin.gcount() != (std::streamsize)binary.size())
+        return false;
+
+    ID = glCreateProgram();
+    glProgramBinary(ID, format, binary.data(), (GLsizei)binary.size());
+    GLint success = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        // a driver update invalidates binaries even when the version string stays
+        glDeleteProgram(ID);
+        ID = 0;
+        return false;
+    }
+    return true;
+}
+
+void Shader::saveBinary(unsigned long long key) const
+{
+    GLint success = 0, length = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if (!success || !GLEW_ARB_get_program_binary)
+        return;
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(ID, length, &length, &format, binary.data());
+
+    // write to a temporary file and rename it, so a concurrent run never reads a partial binary
+    std::string path = binaryPath(key);
+    std::string temp = tempPath(path);
+    std::ofstream fout(temp, std::ios::out | std::ios::binary);
+    fout.write((const char*)&format, sizeof(format));
+    fout.write(binary.data(), length);
+    fout.close();
+    std::error_code ec;
+    if (!fout)
+    {
+        std::filesystem::remove(temp, ec);
+        return;
+    }
+    std::filesystem::rename(temp, path, ec);
+    if (ec)
+        std::filesystem::remove(temp, ec);
+}
+
+void Shader::reflectUniforms()
+{
+    locations.clear();
+    samplers.clear();
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> buffer(maxLength + 1);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+        std::string name(buffer.data(), length);
+        GLint base = glGetUniformLocation(ID, name.c_str());
+        // members of uniform blocks have no location
+        if (base < 0)
+            continue;
+
+        // arrays are reported as name[0]; every element gets an entry, the array name the first
+        size_t bracket = name.find('[');
+        if (bracket != std::string::npos)
+        {
+            std::string array = name.substr(0, bracket);
+            locations[array] = base;
+            for (GLint e = 0; e < size; e++)
+            {
+                std::string element = array + "[" + std::to_string(e) + "]";
+                locations[element] = glGetUniformLocation(ID, element.c_str());
+            }
+            continue;
+        }
+        locations[name] = base;
+
+        // samplers named <type>N, N from 1
+        size_t digits = name.find_last_not_of("0123456789");
+        if (digits != std::string::npos && digits + 1 < name.size())
+        {
+            unsigned int number = (unsigned int)std::stoul(name.substr(digits + 1));
+            if (number > 0)
+            {
+                std::vector<GLint>& slots = samplers[name.substr(0, digits + 1)];
+                if (slots.size() < number)
+                    slots.resize(number, -1);
+                slots[number - 1] = base;
+            }
+        }
+    }
+}
+
+GLint Shader::location(const std::string &name) const
+{
+    auto found = locations.find(name);
+    return found != locations.end() ? found->second : -1;
+}
+
+void Shader::bindBlock(const std::string &name, unsigned int binding) const
+{
+    GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, index, binding);
+}
+
+Uniform Shader::uniform(const std::string &name) const
+{
+    Uniform handle = { location(name) };
+    return handle;
+}
+
+GLint Shader::samplerLocation(const std::string &type, unsigned int number) const
+{
+    auto found = samplers.find(type);
+    if (found == samplers.end() || number == 0 || number > found->second.size())
+        return -1;
+    return found->second[number - 1];
 }
 // utility uniform functions
 // ------------------------------------------------------------------------
 void Shader::setBool(const std::string &name, bool value) const
 {         
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+    glUniform1i(location(name), (int)value); 
 }
 // ------------------------------------------------------------------------
 void Shader::setInt(const std::string &name, int value) const
 { 
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+    glUniform1i(location(name), value); 
 }
 // ------------------------------------------------------------------------
 void Shader::setFloat(const std::string &name, float value) const
 { 
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    glUniform1f(location(name), value); 
 }
 // ------------------------------------------------------------------------
 void Shader::setVec2(const std::string &name, const glm::vec2 &value) const
 { 
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    glUniform2fv(location(name), 1, &value[0]); 
 }
 void Shader::setVec2(const std::string &name, float x, float y) const
 { 
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+    glUniform2f(location(name), x, y); 
 }
 // ------------------------------------------------------------------------
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const
 { 
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    glUniform3fv(location(name), 1, &value[0]); 
 }
 void Shader::setVec3(const std::string &name, float x, float y, float z) const
 { 
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+    glUniform3f(location(name), x, y, z); 
+}
+void Shader::setVec3Array(const std::string &name, const glm::vec3* values, int count) const
+{ 
+    glUniform3fv(location(name), count, &values[0][0]); 
 }
 // ------------------------------------------------------------------------
 void Shader::setVec4(const std::string &name, const glm::vec4 &value) const
 { 
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+    glUniform4fv(location(name), 1, &value[0]); 
 }
 void Shader::setVec4(const std::string &name, float x, float y, float z, float w) 
 { 
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+    glUniform4f(location(name), x, y, z, w); 
 }
 // ------------------------------------------------------------------------
 void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const
 {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
 void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const
 {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
 }
 
 void Shader::checkCompileErrors(GLuint shader, std::string type)
@@ -180,4 +403,32 @@ void Shader::checkCompileErrors(GLuint shader, std::string type)
             std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
         }
     }
-}
\ No newline at end of file
+}
+
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath)
+{
+    this->vertexPath = vertexPath;
+    this->fragmentPath = fragmentPath;
+}
+
+ShaderVariants::~ShaderVariants()
+{
+    for (auto it = variants.begin(); it != variants.end(); ++it)
+    {
+        glDeleteProgram(it->second->ID);
+        delete it->second;
+    }
+}
+
+Shader* ShaderVariants::get(std::vector<std::string> defines)
+{
+    std::sort(defines.begin(), defines.end());
+    defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+    auto found = variants.find(defines);
+    if (found != variants.end())
+        return found->second;
+
+    Shader* shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, defines);
+    variants.insert(std::make_pair(defines, shader));
+    return shader;
+}
@@ -8,22 +8,51 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstdio>
+#include <filesystem>
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <algorithm>
 
+#include "tempfile.h"
+
+// location of a uniform of a linked program, looked up once with Shader::uniform()
+struct Uniform
+{
+    GLint location;
+};
+
+// The active uniforms of the program are reflected once after link into a table of locations,
+// so setting a uniform by name is a hash lookup instead of a glGetUniformLocation round trip.
+// Hot paths look their uniforms up once and keep the Uniform handles.
+// With a binary cache directory set, linked programs are stored there with glGetProgramBinary,
+// keyed by a hash of their sources and the GL vendor, renderer and version, and later loads
+// take the binary instead of compiling. A binary the driver rejects is compiled and replaced.
 class Shader
 {
 public:
     unsigned int ID;
+    // directory of the program binary cache, empty to disable it
+    static void setBinaryCache(const std::string &directory);
     Shader();
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+    // defines are inserted after the #version line of every stage, "NAME" or "NAME VALUE"
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::vector<std::string>& defines = std::vector<std::string>());
     
     // activate the shader
     // ------------------------------------------------------------------------
     void use();
     // load shader
     // ------------------------------------------------------------------------
-    void load(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr);
+    void load(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::vector<std::string>& defines = std::vector<std::string>());
+    // point the uniform block of the program at a binding point; does nothing if the program has no such block
+    void bindBlock(const std::string &name, unsigned int binding) const;
+    // handle of a uniform; its location is -1, and setting it does nothing, if the program doesn't use it
+    Uniform uniform(const std::string &name) const;
+    // location of the sampler <type><number> (texture_diffuse1, ...) from the table, -1 if there is none
+    GLint samplerLocation(const std::string &type, unsigned int number) const;
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const;
@@ -37,6 +66,7 @@ public:
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const;
     void setVec3(const std::string &name, float x, float y, float z) const;
+    void setVec3Array(const std::string &name, const glm::vec3* values, int count) const;
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const;
     void setVec4(const std::string &name, float x, float y, float z, float w);
@@ -46,10 +76,59 @@ public:
     void setMat3(const std::string &name, const glm::mat3 &mat) const;
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
+    // the same through handles
+    // ------------------------------------------------------------------------
+    void setBool(Uniform uniform, bool value) const { glUniform1i(uniform.location, (int)value); }
+    void setInt(Uniform uniform, int value) const { glUniform1i(uniform.location, value); }
+    void setFloat(Uniform uniform, float value) const { glUniform1f(uniform.location, value); }
+    void setVec2(Uniform uniform, const glm::vec2 &value) const { glUniform2fv(uniform.location, 1, &value[0]); }
+    void setVec3(Uniform uniform, const glm::vec3 &value) const { glUniform3fv(uniform.location, 1, &value[0]); }
+    void setVec3Array(Uniform uniform, const glm::vec3* values, int count) const { glUniform3fv(uniform.location, count, &values[0][0]); }
+    void setVec4(Uniform uniform, const glm::vec4 &value) const { glUniform4fv(uniform.location, 1, &value[0]); }
+    void setMat3(Uniform uniform, const glm::mat3 &mat) const { glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+    void setMat4(Uniform uniform, const glm::mat4 &mat) const { glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
 
 private:
+    static std::string binaryCache;
+
+    // 64-bit FNV-1a of the sources and the driver strings, the name of the cached binary
+    static unsigned long long binaryKey(const std::string &vertexCode, const std::string &fragmentCode, const std::string &geometryCode);
+    static std::string binaryPath(unsigned long long key);
+    // link ID from the cached binary of the key; false if there is none or the driver rejects it
+    bool loadBinary(unsigned long long key);
+    void saveBinary(unsigned long long key) const;
+
+    // location of every active uniform, and of every element of the arrays
+    std::unordered_map<std::string, GLint> locations;
+    // sampler locations by type, the location of <type>N at N - 1
+    std::unordered_map<std::string, std::vector<GLint>> samplers;
+
+    static void injectDefines(std::string &code, const std::vector<std::string> &defines);
+    // fill the tables from the linked program
+    void reflectUniforms();
+    GLint location(const std::string &name) const;
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type);
 };
+
+// The programs built from one vertex and fragment source with different sets of defines.
+// A variant is compiled (or taken from the binary cache) the first time its set is asked for
+// and kept for the rest of the run; the order of the defines doesn't matter.
+class ShaderVariants
+{
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::map<std::vector<std::string>, Shader*> variants;
+
+public:
+    ShaderVariants(const char* vertexPath, const char* fragmentPath);
+    ~ShaderVariants();
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    Shader* get(std::vector<std::string> defines);
+};
 #endif
\ No newline at end of file
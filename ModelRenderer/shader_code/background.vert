@@ -1,8 +1,14 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 projection;
-uniform mat4 view;
+// camera, written once per frame (FrameBlock in uniformbuffer.h)
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    mat4 normal_view;
+    vec3 camPos;
+};
 
 out vec3 WorldPos;
 
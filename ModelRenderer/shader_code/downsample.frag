@@ -0,0 +1,24 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform int factor;
+
+void main()
+{
+    // average the factor x factor block of the supersampled image behind this pixel.
+    // the input is gamma encoded, so filter in linear space like the CPU resize did.
+    ivec2 base = ivec2(gl_FragCoord.xy) * factor;
+    vec3 color = vec3(0.0);
+    for (int y = 0; y < factor; ++y)
+    {
+        for (int x = 0; x < factor; ++x)
+        {
+            color += pow(texelFetch(source, base + ivec2(x, y), 0).rgb, vec3(2.2));
+        }
+    }
+    color /= float(factor * factor);
+
+    FragColor = vec4(pow(color, vec3(1.0/2.2)), 1.0);
+}
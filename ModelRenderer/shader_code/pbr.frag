@@ -1,24 +1,53 @@
 #version 330 core
-out vec4 FragColor;
+// variants, defined by Shader when the program is built (see ModelRenderer::createPass):
+//   SHADED_OUTPUT n  write the shaded color to color attachment n
+//   NORMAL_OUTPUT n  write the view-space normal to color attachment n
+//   TEXTURED_ALBEDO  albedo from texture_diffuse1 instead of the material color, no ao
+//   TONEMAP          tonemap and gamma correct the shaded color
+//   SH_IRRADIANCE    diffuse irradiance from shCoeffs instead of irradianceMap
+#ifdef SHADED_OUTPUT
+layout (location = SHADED_OUTPUT) out vec4 FragColor;
+#endif
+#ifdef NORMAL_OUTPUT
+layout (location = NORMAL_OUTPUT) out vec4 NormalColor;
+#endif
 in vec2 TexCoords;
 in vec3 WorldPos;
 in vec3 Normal;
 
-// material parameters
-uniform vec3 albedo;
-uniform float metallic;
-uniform float roughness;
-uniform float ao;
+// camera, written once per frame (FrameBlock in uniformbuffer.h)
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    mat4 normal_view;
+    vec3 camPos;
+};
+
+// model matrix and material of the draw (ObjectBlock in uniformbuffer.h)
+layout (std140) uniform Object
+{
+    mat4 model;
+    vec3 albedo;
+    float metallic;
+    float roughness;
+    float ao;
+};
 
 // IBL
+#ifdef SH_IRRADIANCE
+// L2 spherical harmonics irradiance
+uniform vec3 shCoeffs[9];
+#else
 uniform samplerCube irradianceMap;
+#endif
 uniform samplerCube prefilterMap;
 uniform sampler2D brdfLUT;
 
+#ifdef TEXTURED_ALBEDO
 // texture
 uniform sampler2D texture_diffuse1;
-
-uniform vec3 camPos;
+#endif
 
 const float PI = 3.14159265359;
 // ----------------------------------------------------------------------------
@@ -67,18 +96,45 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }   
 // ----------------------------------------------------------------------------
+#ifdef SH_IRRADIANCE
+vec3 irradianceSH(vec3 n)
+{
+    // the cosine convolution is already folded into the coefficients
+    vec3 result = shCoeffs[0] * 0.282095
+                + shCoeffs[1] * 0.488603 * n.y
+                + shCoeffs[2] * 0.488603 * n.z
+                + shCoeffs[3] * 0.488603 * n.x
+                + shCoeffs[4] * 1.092548 * n.x * n.y
+                + shCoeffs[5] * 1.092548 * n.y * n.z
+                + shCoeffs[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+                + shCoeffs[7] * 1.092548 * n.x * n.z
+                + shCoeffs[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+    return max(result, vec3(0.0));
+}
+#endif
+// ----------------------------------------------------------------------------
 void main()
 {		
+#ifdef NORMAL_OUTPUT
+    NormalColor = normal_view * vec4(Normal, 1.0) * 0.5f + 0.5f;
+#endif
+#ifdef SHADED_OUTPUT
     vec3 N = normalize(Normal);
     vec3 V = normalize(camPos - WorldPos);
     vec3 R = reflect(-V, N); 
 
-    vec3 albedoMap = pow(texture(texture_diffuse1, TexCoords).rgb, vec3(2.2));
+#ifdef TEXTURED_ALBEDO
+    vec3 baseColor = pow(texture(texture_diffuse1, TexCoords).rgb, vec3(2.2));
+    float occlusion = 1.0;
+#else
+    vec3 baseColor = albedo;
+    float occlusion = ao;
+#endif
 
     // calculate reflectance at normal incidence; if dia-electric (like plastic) use F0 
     // of 0.04 and if it's a metal, use the albedo color as F0 (metallic workflow)    
     vec3 F0 = vec3(0.04); 
-    F0 = mix(F0, albedo, metallic);
+    F0 = mix(F0, baseColor, metallic);
 
     // ambient lighting (we now use IBL as the ambient term)
     vec3 F = fresnelSchlickRoughness(max(dot(N, V), 0.0), F0, roughness);
@@ -87,8 +143,12 @@ void main()
     vec3 kD = 1.0 - kS;
     kD *= 1.0 - metallic;	  
        
+#ifdef SH_IRRADIANCE
+    vec3 irradiance = irradianceSH(N);
+#else
     vec3 irradiance = texture(irradianceMap, N).rgb;
-    vec3 diffuse    = irradiance * albedo;
+#endif
+    vec3 diffuse    = irradiance * baseColor;
     
     // sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
     const float MAX_REFLECTION_LOD = 4.0;
@@ -96,12 +156,15 @@ void main()
     vec2 brdf  = texture(brdfLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
     vec3 specular = prefilteredColor * (F * brdf.x + brdf.y);
     
-    vec3 color = (kD * diffuse + specular) * ao;
+    vec3 color = (kD * diffuse + specular) * occlusion;
 
+#ifdef TONEMAP
     // HDR tonemapping
     color = color / (color + vec3(1.0));
     // gamma correct
     color = pow(color, vec3(1.0/2.2)); 
+#endif
 
     FragColor = vec4(color, 1.0);
-}
\ No newline at end of file
+#endif
+}
@@ -7,15 +7,39 @@ out vec2 TexCoords;
 out vec3 WorldPos;
 out vec3 Normal;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// camera, written once per frame (FrameBlock in uniformbuffer.h)
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    mat4 normal_view;
+    vec3 camPos;
+};
+// model matrix and material of the draw (ObjectBlock in uniformbuffer.h)
+layout (std140) uniform Object
+{
+    mat4 model;
+    vec3 albedo;
+    float metallic;
+    float roughness;
+    float ao;
+};
+// normals are octahedral encoded in aNormal.xy (see vertexlayout.h)
+uniform bool octNormals;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
 
 void main()
 {
     TexCoords = aTexCoords;
     WorldPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;   
+    Normal = octNormals ? octDecode(aNormal.xy) : aNormal;
 
     gl_Position =  projection * view * vec4(WorldPos, 1.0);
 }
\ No newline at end of file
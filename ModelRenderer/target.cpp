@@ -0,0 +1,126 @@
+#include "target.h"
+
+// create a 2D texture and attach it as the only color buffer of a new framebuffer
+static unsigned int createColorTarget(unsigned int& fbo, int width, int height)
+{
+    unsigned int tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "RenderTarget :: incomplete color framebuffer." << std::endl;
+    return tex;
+}
+
+RenderTarget::RenderTarget(int width, int height, int supersample, int samples, Shader* downsample, int outputs)
+{
+    this->width = width;
+    this->height = height;
+    this->supersample = supersample > 1 ? supersample : 1;
+    this->samples = samples > 1 ? samples : 0;
+    outputs = outputs > 1 ? outputs : 1;
+    int rw = width * this->supersample;
+    int rh = height * this->supersample;
+
+    colorRBOs.resize(outputs);
+    glGenRenderbuffers(outputs, colorRBOs.data());
+    for (int i = 0; i < outputs; i++)
+    {
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRBOs[i]);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, this->samples, GL_RGBA8, rw, rh);
+    }
+    glGenRenderbuffers(1, &depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, this->samples, GL_DEPTH_COMPONENT24, rw, rh);
+
+    glGenFramebuffers(1, &renderFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderFBO);
+    std::vector<GLenum> drawBuffers(outputs);
+    for (int i = 0; i < outputs; i++)
+    {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_RENDERBUFFER, colorRBOs[i]);
+        drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    }
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    glDrawBuffers(outputs, drawBuffers.data());
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "RenderTarget :: incomplete render framebuffer." << std::endl;
+
+    resolveFBOs.assign(outputs, 0);
+    resolveTexs.assign(outputs, 0);
+    outputFBOs.assign(outputs, 0);
+    outputTexs.assign(outputs, 0);
+    for (int i = 0; i < outputs; i++)
+    {
+        if (this->supersample > 1)
+            resolveTexs[i] = createColorTarget(resolveFBOs[i], rw, rh);
+        outputTexs[i] = createColorTarget(outputFBOs[i], width, height);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    pShader = downsample;
+    factor = pShader->uniform("factor");
+}
+
+void RenderTarget::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, renderFBO);
+    glViewport(0, 0, width * supersample, height * supersample);
+}
+
+void RenderTarget::resolve()
+{
+    int rw = width * supersample;
+    int rh = height * supersample;
+
+    for (unsigned int i = 0; i < outputFBOs.size(); i++)
+    {
+        // resolve the MSAA samples; a multisample blit has to keep the size, so it goes to the
+        // supersampled texture first when we still need to downsample
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, renderFBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, supersample > 1 ? resolveFBOs[i] : outputFBOs[i]);
+        glBlitFramebuffer(0, 0, rw, rh, 0, 0, rw, rh, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        if (supersample > 1)
+        {
+            // box filter supersample x supersample texels into each output pixel
+            glBindFramebuffer(GL_FRAMEBUFFER, outputFBOs[i]);
+            glViewport(0, 0, width, height);
+            glDisable(GL_DEPTH_TEST);
+            // the shader is shared, so the factor of this target is set on every use
+            pShader->use();
+            pShader->setInt(factor, supersample);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, resolveTexs[i]);
+            quad.render();
+            glEnable(GL_DEPTH_TEST);
+        }
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, renderFBO);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, outputFBOs[0]);
+}
+
+void RenderTarget::readOutput(int output)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, outputFBOs[output]);
+}
+
+void RenderTarget::present(int windowWidth, int windowHeight)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, outputFBOs[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,56 @@
+#ifndef _TARGET_H_
+#define _TARGET_H_
+
+#include <GL/glew.h>
+#include <iostream>
+#include <vector>
+
+#include "shader.h"
+#include "polygon.h"
+
+// Offscreen export target at the size of the saved images, with one color attachment per output
+// image, so one pass can write several images of the same view through multiple render targets.
+// The scene is drawn into a (multisampled) framebuffer of supersample times the output size.
+// resolve() resolves the MSAA samples with a blit and, when supersampling, box-filters the
+// result down to the output size on the GPU, so only output-sized pixels are ever read back.
+class RenderTarget
+{
+private:
+    int width;
+    int height;
+    int supersample;
+    int samples;
+
+    // framebuffer the scene is rendered into, at width * supersample
+    unsigned int renderFBO;
+    std::vector<unsigned int> colorRBOs;
+    unsigned int depthRBO;
+    // single-sampled copies of the render attachments, only used when supersampling
+    std::vector<unsigned int> resolveFBOs;
+    std::vector<unsigned int> resolveTexs;
+    // output sized framebuffers the screenshots are read from
+    std::vector<unsigned int> outputFBOs;
+    std::vector<unsigned int> outputTexs;
+
+    Quad quad;
+    // box filter of downsample.frag, shared by every target and not owned
+    Shader* pShader;
+    Uniform factor;
+
+public:
+    RenderTarget(int width, int height, int supersample, int samples, Shader* downsample, int outputs = 1);
+
+    // bind the render framebuffer and set the viewport to cover it
+    void bind();
+    // resolve and downsample every output; the first one is left bound for reading
+    void resolve();
+    // bind an output for reading
+    void readOutput(int output);
+    // copy the first output onto the window's back buffer as a preview
+    void present(int windowWidth, int windowHeight);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _TEMPFILE_H_
+#define _TEMPFILE_H_
+
+#include <string>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// name of a temporary file next to path, to be renamed over it once fully written.
+// the name is unique per process, thread and call, so concurrent jobs writing the same
+// cache file never share (and interleave) a temporary.
+inline std::string tempPath(const std::string& path)
+{
+    static std::atomic<unsigned int> counter(0);
+#ifdef _WIN32
+    int pid = _getpid();
+#else
+    int pid = (int)getpid();
+#endif
+    std::ostringstream ss;
+    ss << path << "." << pid << "." << std::this_thread::get_id() << "." << counter++ << ".tmp";
+    return ss.str();
+}
+
+#endif
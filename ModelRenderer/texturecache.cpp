@@ -0,0 +1,124 @@
+#include "texturecache.h"
+
+#include "imageload.h"
+
+TextureCache& TextureCache::shared()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+std::string TextureCache::canonicalPath(const std::string& path)
+{
+    std::error_code ec;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, ec);
+    if (ec)
+        canonical = std::filesystem::path(path).lexically_normal();
+    return canonical.generic_string();
+}
+
+unsigned int TextureCache::upload(const Image& image)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    if (!image.data)
+    {
+        std::cout << "Texture failed to load at path: " << image.key << std::endl;
+        return textureID;
+    }
+
+    GLenum format = GL_RGBA;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 3)
+        format = GL_RGB;
+    else if (image.components == 4)
+        format = GL_RGBA;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    // rows of 1 and 3 component images aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return textureID;
+}
+
+void TextureCache::load(const std::vector<std::string>& paths, unsigned int threads)
+{
+    // the files without a texture, each once
+    std::vector<std::string> missing;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        std::string key = canonicalPath(paths[i]);
+        if (textures.insert(std::make_pair(key, 0u)).second)
+            missing.push_back(key);
+    }
+    if (missing.empty())
+        return;
+
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    threads = std::max(1u, std::min(threads, (unsigned int)missing.size()));
+
+    // the workers decode, this thread uploads whatever is decoded
+    std::atomic<size_t> next(0);
+    std::deque<Image> ready;
+    std::mutex mutex;
+    std::condition_variable decoded;
+    auto worker = [&]() {
+        for (size_t i = next++; i < missing.size(); i = next++)
+        {
+            Image image;
+            image.key = missing[i];
+            // the UVs are flipped on import (aiProcess_FlipUVs), so the rows stay top first
+            image.data = loadImage(image.key.c_str(), &image.width, &image.height, &image.components, 0, false);
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(image);
+            decoded.notify_one();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int t = 0; t < threads; t++)
+        pool.push_back(std::thread(worker));
+
+    for (size_t uploaded = 0; uploaded < missing.size(); uploaded++)
+    {
+        Image image;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            decoded.wait(lock, [&]() { return !ready.empty(); });
+            image = ready.front();
+            ready.pop_front();
+        }
+        textures[image.key] = upload(image);
+        stbi_image_free(image.data);
+    }
+    for (unsigned int t = 0; t < pool.size(); t++)
+        pool[t].join();
+}
+
+unsigned int TextureCache::get(const std::string& path)
+{
+    std::string key = canonicalPath(path);
+    auto found = textures.find(key);
+    if (found == textures.end())
+    {
+        load(std::vector<std::string>(1, path), 1);
+        found = textures.find(key);
+    }
+    return found->second;
+}
+
+void TextureCache::clear()
+{
+    for (auto it = textures.begin(); it != textures.end(); ++it)
+        glDeleteTextures(1, &it->second);
+    textures.clear();
+}
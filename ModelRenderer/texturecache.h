@@ -0,0 +1,58 @@
+#ifndef _TEXTURECACHE_H_
+#define _TEXTURECACHE_H_
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <algorithm>
+#include <iostream>
+
+// Process-wide cache of the 2D textures of model materials, keyed by the canonical path of the
+// image file, so every Model loading the same file shares one GL texture. load() decodes the
+// missing files on worker threads and uploads each one on the calling (context) thread as soon
+// as it is decoded, so the uploads overlap the decodes of the other files.
+class TextureCache
+{
+private:
+    // a decoded image waiting for its upload
+    struct Image
+    {
+        std::string key;
+        unsigned char* data;    // stbi allocation, NULL if the file couldn't be read
+        int width;
+        int height;
+        int components;
+    };
+
+    std::unordered_map<std::string, unsigned int> textures;
+
+    // the textures outlive the context at exit, so they are only deleted by clear()
+    TextureCache() {}
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    static unsigned int upload(const Image& image);
+
+public:
+    static TextureCache& shared();
+
+    // canonical form of a path, the key of its texture
+    static std::string canonicalPath(const std::string& path);
+
+    // make sure every file has a texture; threads == 0 decodes on all hardware threads
+    void load(const std::vector<std::string>& paths, unsigned int threads = 0);
+    // the texture of a file, loading it on the spot if load() hasn't been called for it
+    unsigned int get(const std::string& path);
+    // delete every texture; must be called while the context is current
+    void clear();
+};
+
+#endif
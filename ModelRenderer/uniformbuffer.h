@@ -0,0 +1,69 @@
+#ifndef _UNIFORMBUFFER_H_
+#define _UNIFORMBUFFER_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// binding points of the uniform blocks the shaders share (see Shader::bindBlock)
+enum UniformBlock_Binding {
+    FRAME_BLOCK = 0,    // Frame: camera
+    OBJECT_BLOCK = 1    // Object: model matrix and material
+};
+
+// std140 layout of the Frame block of pbr.vert, pbr.frag and background.vert
+struct FrameBlock
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 normalView;
+    glm::vec3 camPos;
+    float pad;
+};
+
+// std140 layout of the Object block; a float packs into the last component of the vec3 before it
+struct ObjectBlock
+{
+    glm::mat4 model;
+    glm::vec3 albedo;
+    float metallic;
+    float roughness;
+    float ao;
+    float pad[2];
+};
+
+// A uniform buffer holding one block, bound to its binding point for good. The CPU copy is
+// filled in place and uploaded with a single write by update().
+template <typename Block>
+class UniformBuffer
+{
+private:
+    unsigned int id;
+
+public:
+    Block data;
+
+    UniformBuffer(unsigned int binding)
+    {
+        data = Block();
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+    }
+    ~UniformBuffer()
+    {
+        glDeleteBuffers(1, &id);
+    }
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void update()
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+
+#endif
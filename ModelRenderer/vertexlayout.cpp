@@ -0,0 +1,162 @@
+#include "vertexlayout.h"
+
+// octahedral mapping of a unit vector onto [-1, 1]^2
+static glm::vec2 octEncode(glm::vec3 n)
+{
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (sum <= 0.0f)
+        return glm::vec2(0.0f);
+    n /= sum;
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f)
+    {
+        p.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        p.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return p;
+}
+
+VertexLayout::VertexLayout()
+    : VertexLayout(POSITION_FLOAT, TEXCOORD_FLOAT, true, true, false)
+{
+}
+
+VertexLayout::VertexLayout(Position_Format position, TexCoord_Format texCoords, bool normals, bool tangents, bool octahedral)
+{
+    this->position = position;
+    this->texCoords = texCoords;
+    this->normals = normals;
+    this->tangents = tangents;
+    this->octahedral = octahedral;
+    computeOffsets();
+}
+
+VertexLayout VertexLayout::forProgram(unsigned int program, Position_Format position, TexCoord_Format texCoords, bool octahedral)
+{
+    // the linker drops attributes that don't reach an output, so they report no location
+    bool uv = glGetAttribLocation(program, "aTexCoords") >= 0;
+    bool normal = glGetAttribLocation(program, "aNormal") >= 0;
+    bool tangent = glGetAttribLocation(program, "aTangent") >= 0 || glGetAttribLocation(program, "aBitangent") >= 0;
+    return VertexLayout(position, uv ? texCoords : TEXCOORD_NONE, normal, tangent, octahedral);
+}
+
+void VertexLayout::computeOffsets()
+{
+    // every attribute starts on a 4 byte boundary
+    unsigned int offset = position == POSITION_FLOAT ? 12 : 8;
+    texCoordOffset = offset;
+    if (texCoords == TEXCOORD_FLOAT)
+        offset += 8;
+    else if (texCoords != TEXCOORD_NONE)
+        offset += 4;
+    unsigned int direction = octahedral ? 4 : 12;
+    normalOffset = offset;
+    if (normals)
+        offset += direction;
+    tangentOffset = offset;
+    bitangentOffset = offset + direction;
+    if (tangents)
+        offset += 2 * direction;
+    stride = offset;
+}
+
+unsigned int VertexLayout::key() const
+{
+    return (unsigned int)position | ((unsigned int)texCoords << 2) | ((unsigned int)normals << 4)
+        | ((unsigned int)tangents << 5) | ((unsigned int)octahedral << 6) | (stride << 8);
+}
+
+static void packDirection(const glm::vec3& v, bool octahedral, unsigned char* dst)
+{
+    if (octahedral)
+    {
+        unsigned int packed = glm::packSnorm2x16(octEncode(v));
+        memcpy(dst, &packed, 4);
+    }
+    else
+        memcpy(dst, &v, 12);
+}
+
+void VertexLayout::pack(const Vertex* vertices, size_t count, unsigned char* dst) const
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const Vertex& v = vertices[i];
+        unsigned char* out = dst + i * stride;
+
+        if (position == POSITION_FLOAT)
+            memcpy(out, &v.Position, 12);
+        else
+        {
+            unsigned int xy = glm::packHalf2x16(glm::vec2(v.Position.x, v.Position.y));
+            unsigned int zw = glm::packHalf2x16(glm::vec2(v.Position.z, 1.0f));
+            memcpy(out, &xy, 4);
+            memcpy(out + 4, &zw, 4);
+        }
+
+        if (texCoords == TEXCOORD_FLOAT)
+            memcpy(out + texCoordOffset, &v.TexCoords, 8);
+        else if (texCoords == TEXCOORD_HALF)
+        {
+            unsigned int uv = glm::packHalf2x16(v.TexCoords);
+            memcpy(out + texCoordOffset, &uv, 4);
+        }
+        else if (texCoords == TEXCOORD_UNORM16)
+        {
+            unsigned int uv = glm::packUnorm2x16(v.TexCoords);
+            memcpy(out + texCoordOffset, &uv, 4);
+        }
+
+        if (normals)
+            packDirection(v.Normal, octahedral, out + normalOffset);
+        if (tangents)
+        {
+            packDirection(v.Tangent, octahedral, out + tangentOffset);
+            packDirection(v.Bitangent, octahedral, out + bitangentOffset);
+        }
+    }
+}
+
+static void directionAttribute(unsigned int location, bool octahedral, unsigned int stride, unsigned int offset)
+{
+    glEnableVertexAttribArray(location);
+    if (octahedral)
+        glVertexAttribPointer(location, 2, GL_SHORT, GL_TRUE, stride, (void*)(size_t)offset);
+    else
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)offset);
+}
+
+void VertexLayout::setupAttributes() const
+{
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    if (position == POSITION_FLOAT)
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    else
+        glVertexAttribPointer(0, 4, GL_HALF_FLOAT, GL_FALSE, stride, (void*)0);
+    // vertex texture coords
+    if (texCoords == TEXCOORD_FLOAT)
+    {
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)texCoordOffset);
+    }
+    else if (texCoords == TEXCOORD_HALF)
+    {
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(size_t)texCoordOffset);
+    }
+    else if (texCoords == TEXCOORD_UNORM16)
+    {
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(size_t)texCoordOffset);
+    }
+    // vertex normals
+    if (normals)
+        directionAttribute(2, octahedral, stride, normalOffset);
+    // vertex tangent and bitangent
+    if (tangents)
+    {
+        directionAttribute(3, octahedral, stride, tangentOffset);
+        directionAttribute(4, octahedral, stride, bitangentOffset);
+    }
+}
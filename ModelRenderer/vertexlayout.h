@@ -0,0 +1,78 @@
+#ifndef _VERTEXLAYOUT_H_
+#define _VERTEXLAYOUT_H_
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+
+// vertex as imported, before it is packed for the GPU
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+enum Position_Format {
+    POSITION_FLOAT,     // 3 x fp32
+    POSITION_HALF       // 4 x fp16 (w = 1)
+};
+
+enum TexCoord_Format {
+    TEXCOORD_NONE,
+    TEXCOORD_FLOAT,     // 2 x fp32
+    TEXCOORD_HALF,      // 2 x fp16
+    TEXCOORD_UNORM16    // 2 x unorm16, only for UVs inside [0, 1]; others are clamped
+};
+
+// GPU layout of the vertex buffer of a mesh. Attributes keep the locations the shaders declare
+// (0 aPos, 1 aTexCoords, 2 aNormal, 3 aTangent, 4 aBitangent) and are only stored when they
+// are used. Octahedral directions are 2 x snorm16 and are decoded in the vertex shader
+// (octNormals uniform of pbr.vert).
+class VertexLayout
+{
+public:
+    Position_Format position;
+    TexCoord_Format texCoords;
+    bool normals;
+    bool tangents;
+    bool octahedral;
+
+    // default: every attribute as fp32, the same data the importer fills
+    VertexLayout();
+    VertexLayout(Position_Format position, TexCoord_Format texCoords, bool normals, bool tangents, bool octahedral);
+
+    // the attributes the linked program reads, in the given formats
+    static VertexLayout forProgram(unsigned int program, Position_Format position, TexCoord_Format texCoords, bool octahedral);
+
+    unsigned int getStride() const { return stride; }
+    // identifies the layout, so cached vertex data can be checked against it
+    unsigned int key() const;
+
+    // pack count vertices into dst, count * getStride() bytes
+    void pack(const Vertex* vertices, size_t count, unsigned char* dst) const;
+    // set the attribute pointers of the bound VAO for the bound vertex buffer
+    void setupAttributes() const;
+
+private:
+    unsigned int stride;
+    unsigned int texCoordOffset;
+    unsigned int normalOffset;
+    unsigned int tangentOffset;
+    unsigned int bitangentOffset;
+
+    void computeOffsets();
+};
+
+#endif
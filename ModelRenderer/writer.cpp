@@ -0,0 +1,113 @@
+#include "writer.h"
+#include "stb_image_write.h"
+#include "stb_image_resize.h"
+#include "imageload.h"
+
+#include <cstring>
+
+bool writeScreenshot(const std::string& filename, const unsigned char* data, int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+{
+    int nRow = dstWidth * 4;
+    int nSize = nRow * dstHeight;
+    unsigned char* resizedBuffer = (unsigned char*)malloc(nSize * sizeof(unsigned char));
+    if (!resizedBuffer) {
+        std::cout << "writeScreenshot() :: buffer allocation error." << std::endl;
+        return false;
+    }
+
+    // frames rendered at the output size only need the flip
+    if (srcWidth == dstWidth && srcHeight == dstHeight)
+        memcpy(resizedBuffer, data, nSize);
+    else
+        stbir_resize(data, srcWidth, srcHeight, 0, resizedBuffer, dstWidth, dstHeight, 0,
+            STBIR_TYPE_UINT8, 4, STBIR_ALPHA_CHANNEL_NONE, 0,
+            STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+            STBIR_COLORSPACE_SRGB, nullptr);
+
+    // OpenGL rows start at the bottom. flip here rather than through stbi_flip_vertically_on_write(),
+    // which is a global flag and not safe to toggle while other threads are encoding.
+    flipRows(resizedBuffer, dstWidth, dstHeight, 4);
+    stbi_write_jpg(filename.c_str(), dstWidth, dstHeight, 4, resizedBuffer, 100);
+
+    free(resizedBuffer);
+
+    // one insertion per line so messages from different workers don't interleave
+    std::cout << ("saving screenshot(" + filename + ")\n");
+    return true;
+}
+
+ImageWriter::ImageWriter(unsigned int threads, unsigned int capacity)
+{
+    if (threads == 0)
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        threads = cores > 1 ? cores - 1 : 1;
+    }
+    this->capacity = capacity > 0 ? capacity : 1;
+    active = 0;
+    stopping = false;
+
+    for (unsigned int i = 0; i < threads; i++)
+        workers.push_back(std::thread(&ImageWriter::work, this));
+}
+
+ImageWriter::~ImageWriter()
+{
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ImageWriter::submit(const std::string& filename, std::vector<unsigned char>&& pixels, int width, int height, int outWidth, int outHeight)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    // backpressure: hold the render thread until a worker frees a slot
+    notFull.wait(lock, [this] { return jobs.size() < capacity; });
+
+    Job job;
+    job.filename = filename;
+    job.pixels = std::move(pixels);
+    job.width = width;
+    job.height = height;
+    job.outWidth = outWidth;
+    job.outHeight = outHeight;
+    jobs.push_back(std::move(job));
+    lock.unlock();
+
+    notEmpty.notify_one();
+}
+
+void ImageWriter::drain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return jobs.empty() && active == 0; });
+}
+
+void ImageWriter::work()
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+            return;
+
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        active++;
+        lock.unlock();
+        notFull.notify_one();
+
+        writeScreenshot(job.filename, job.pixels.data(), job.width, job.height, job.outWidth, job.outHeight);
+
+        lock.lock();
+        active--;
+        lock.unlock();
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef _WRITER_H_
+#define _WRITER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+// resize a RGBA8 frame (bottom row first) to the output size and write it to disk as a jpg
+bool writeScreenshot(const std::string& filename, const unsigned char* data, int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+// Bounded pool of encoder threads. Each job resizes, flips, encodes and writes one frame.
+// submit() blocks while the queue is full so the render loop can't run away from the encoders,
+// and drain() returns only once every submitted frame is on disk.
+class ImageWriter
+{
+private:
+    struct Job
+    {
+        std::string filename;
+        std::vector<unsigned char> pixels;
+        int width;
+        int height;
+        int outWidth;
+        int outHeight;
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable notEmpty;   // signalled when a job is queued or on shutdown
+    std::condition_variable notFull;    // signalled when a worker takes a job
+    std::condition_variable idle;       // signalled when a worker finishes a job
+    unsigned int capacity;
+    unsigned int active;
+    bool stopping;
+
+    void work();
+
+public:
+    // threads == 0 picks one thread per hardware core, leaving one for the render thread
+    ImageWriter(unsigned int threads = 0, unsigned int capacity = 8);
+    ~ImageWriter();
+
+    void submit(const std::string& filename, std::vector<unsigned char>&& pixels, int width, int height, int outWidth, int outHeight);
+    // wait until the queue is empty and every worker is idle
+    void drain();
+};
+
+#endif